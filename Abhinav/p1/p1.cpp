@@ -1,6 +1,13 @@
 // ambulance_dispatch.cpp
-// Compile: g++ -std=c++17 -O2 -o ambulance_dispatch ambulance_dispatch.cpp
-// Usage: ./ambulance_dispatch incidents.csv
+// Compile: g++ -std=c++17 -O2 -pthread -o ambulance_dispatch ambulance_dispatch.cpp
+// Usage: ./ambulance_dispatch incidents.csv [--batch WINDOW_SECONDS] [--k K] [--threads T]
+//
+// Default mode pops incidents in priority order and greedily sends the nearest
+// available ambulance. --batch groups incidents into time windows and solves each
+// window as a severity-weighted assignment problem (minimise sum of severity * distance)
+// on a sparse candidate graph built from the K nearest available ambulances:
+//  - small batches: sparse shortest augmenting path (Jonker-Volgenant augmentation)
+//  - large batches: epsilon-scaling auction with Jacobi bidding split across threads
 #include <bits/stdc++.h>
 using namespace std;
 
@@ -38,15 +45,264 @@ double euclidDist(const Incident &ins, const Ambulance &amb) {
     return sqrt(dx*dx + dy*dy);
 }
 
+// ---------------- Batched dispatch ----------------
+
+// Cost of leaving an incident unserved in its window. Larger than any trip on the
+// 100km x 100km service area, and scaled by severity so that when ambulances run
+// short the most critical incidents keep theirs.
+const long long UNSERVED_COST_PER_SEVERITY = 1000000;
+// Batches up to this size go to the augmenting path solver, larger ones to the auction.
+const int JV_MAX_BATCH = 128;
+// Auction rounds with fewer bidders than this are cheaper to run on one thread.
+const int AUCTION_PARALLEL_MIN_BIDDERS = 1024;
+
+struct CandidateEdge {
+    int amb;          // index into ambulances
+    double dist;
+    long long cost;   // severity * distance, rounded to whole metres
+};
+
+// Run fn(begin, end) over [0, n) split into contiguous chunks, one per thread.
+template <class F>
+void parallel_for(int n, int threads, F fn) {
+    if (threads <= 1 || n < 2) { fn(0, n); return; }
+    int t = min(threads, n);
+    int chunk = (n + t - 1) / t;
+    vector<thread> pool;
+    for (int b = 0; b < n; b += chunk) pool.emplace_back(fn, b, min(n, b + chunk));
+    for (auto &th : pool) th.join();
+}
+
+// K nearest available ambulances for every incident of the batch (parallel over incidents)
+vector<vector<CandidateEdge>> build_candidates(const vector<Incident> &batch, const vector<Ambulance> &ambulances,
+                                               const vector<int> &avail, int K, int threads) {
+    vector<vector<CandidateEdge>> cand(batch.size());
+    int k = min<int>(K, avail.size());
+    if (batch.size() * avail.size() < (1u << 15)) threads = 1;
+    parallel_for((int)batch.size(), threads, [&](int b, int e) {
+        vector<pair<double,int>> tmp(avail.size());
+        for (int i = b; i < e; ++i) {
+            for (size_t a = 0; a < avail.size(); ++a) tmp[a] = {euclidDist(batch[i], ambulances[avail[a]]), avail[a]};
+            partial_sort(tmp.begin(), tmp.begin() + k, tmp.end());
+            cand[i].reserve(k);
+            for (int j = 0; j < k; ++j)
+                cand[i].push_back({tmp[j].second, tmp[j].first, llround(batch[i].severity * tmp[j].first)});
+        }
+    });
+    return cand;
+}
+
+// Sparse rectangular assignment. Row i may take any column in adj[i]; every row owns a
+// private "unserved" column so a full row assignment always exists. Returns the column of
+// each row. Shortest augmenting paths with column potentials (the augmentation phase of
+// Jonker-Volgenant), Dijkstra restricted to the candidate edges.
+vector<int> solve_sparse_sap(const vector<vector<pair<int,long long>>> &adj, int ncols) {
+    const long long INF = numeric_limits<long long>::max() / 4;
+    int nrows = adj.size();
+    vector<long long> u(nrows, 0), v(ncols, 0), d(ncols, INF);
+    vector<int> col_of(nrows, -1), row_of(ncols, -1), pred(ncols, -1);
+    vector<char> done(ncols, 0);
+    vector<int> touched;
+    for (int r0 = 0; r0 < nrows; ++r0) {
+        priority_queue<pair<long long,int>, vector<pair<long long,int>>, greater<>> pq;
+        touched.clear();
+        auto relax = [&](int r, long long base) {
+            for (auto [c, cost] : adj[r]) {
+                if (done[c]) continue;
+                long long nd = base + cost - u[r] - v[c];
+                if (nd < d[c]) {
+                    if (d[c] == INF) touched.push_back(c);
+                    d[c] = nd; pred[c] = r;
+                    pq.push({nd, c});
+                }
+            }
+        };
+        relax(r0, 0);
+        int free_col = -1;
+        long long dstar = 0;
+        vector<int> settled;
+        while (!pq.empty()) {
+            auto [dc, c] = pq.top(); pq.pop();
+            if (done[c] || dc != d[c]) continue;
+            done[c] = 1; settled.push_back(c);
+            if (row_of[c] < 0) { free_col = c; dstar = dc; break; }
+            relax(row_of[c], dc);
+        }
+        // free_col always exists: the row's own unserved column is free until it is used
+        for (int c : settled) {
+            if (row_of[c] >= 0) u[row_of[c]] += dstar - d[c];
+            v[c] += d[c] - dstar;
+        }
+        u[r0] += dstar;
+        for (int c = free_col;;) {
+            int r = pred[c];
+            int prev = col_of[r];
+            col_of[r] = c; row_of[c] = r;
+            if (r == r0) break;
+            c = prev;
+        }
+        for (int c : touched) { d[c] = INF; done[c] = 0; }
+    }
+    return col_of;
+}
+
+// Same problem solved by an epsilon-scaling forward auction. The rectangular problem is
+// made square by adding one "idle" bidder per ambulance that can keep its ambulance or
+// take the unserved column of any incident that lists this ambulance as a candidate, so
+// a perfect matching always exists. Costs are scaled by (n+1) so the final eps = 1 phase
+// gives an exactly optimal assignment. While many bidders are unassigned they all bid at
+// once (Jacobi) with the bids split across threads; the tail runs Gauss-Seidel.
+vector<int> solve_sparse_auction(const vector<vector<pair<int,long long>>> &adj, int ncols, int namb,
+                                 int threads) {
+    int nrows = adj.size();
+    // Objects are the ncols columns (namb ambulances + one unserved column per row);
+    // bidders are the rows plus one idle bidder per ambulance, so both number ncols.
+    int n = ncols;
+    vector<vector<pair<int,long long>>> ben(n);
+    long long scale = n + 1, maxben = 1;
+    for (int i = 0; i < nrows; ++i) {
+        for (auto [c, cost] : adj[i]) {
+            ben[i].push_back({c, -cost * scale});
+            maxben = max(maxben, cost * scale);
+            if (c < namb) ben[nrows + c].push_back({namb + i, 0});
+        }
+    }
+    for (int a = 0; a < namb; ++a) ben[nrows + a].push_back({a, 0});
+
+    vector<long long> price(n, 0), best_bid(n);
+    vector<int> owner(n), obj_of(n), best_bidder(n);
+    vector<pair<int,long long>> bids;
+    vector<int> unassigned, next_unassigned, bid_objs;
+    long long eps = max(1LL, maxben / 8);
+    while (true) {
+        fill(owner.begin(), owner.end(), -1);
+        fill(obj_of.begin(), obj_of.end(), -1);
+        fill(best_bidder.begin(), best_bidder.end(), -1);
+        unassigned.resize(n);
+        iota(unassigned.begin(), unassigned.end(), 0);
+        auto make_bid = [&](int i) {
+            long long v1 = LLONG_MIN, v2 = LLONG_MIN;
+            int j1 = -1;
+            for (auto [j, bj] : ben[i]) {
+                long long val = bj - price[j];
+                if (val > v1) { v2 = v1; v1 = val; j1 = j; }
+                else if (val > v2) v2 = val;
+            }
+            long long incr = (v2 == LLONG_MIN ? maxben : v1 - v2) + eps;
+            return pair<int,long long>(j1, price[j1] + incr);
+        };
+        while (!unassigned.empty()) {
+            if ((int)unassigned.size() < AUCTION_PARALLEL_MIN_BIDDERS || threads == 1) {
+                // Few bidders left: Gauss-Seidel, one bid at a time sees the latest prices
+                int i = unassigned.back(); unassigned.pop_back();
+                auto [j, b] = make_bid(i);
+                if (owner[j] >= 0) { obj_of[owner[j]] = -1; unassigned.push_back(owner[j]); }
+                owner[j] = i; obj_of[i] = j; price[j] = b;
+                continue;
+            }
+            bids.resize(unassigned.size());
+            parallel_for((int)unassigned.size(), threads, [&](int b, int e) {
+                for (int k = b; k < e; ++k) bids[k] = make_bid(unassigned[k]);
+            });
+            bid_objs.clear();
+            for (size_t k = 0; k < unassigned.size(); ++k) {
+                auto [j, b] = bids[k];
+                if (best_bidder[j] < 0) { bid_objs.push_back(j); best_bidder[j] = unassigned[k]; best_bid[j] = b; }
+                else if (b > best_bid[j]) { best_bidder[j] = unassigned[k]; best_bid[j] = b; }
+            }
+            next_unassigned.clear();
+            for (size_t k = 0; k < unassigned.size(); ++k)
+                if (best_bidder[bids[k].first] != unassigned[k]) next_unassigned.push_back(unassigned[k]);
+            for (int j : bid_objs) {
+                int w = best_bidder[j];
+                if (owner[j] >= 0) { obj_of[owner[j]] = -1; next_unassigned.push_back(owner[j]); }
+                owner[j] = w; obj_of[w] = j; price[j] = best_bid[j];
+                best_bidder[j] = -1;
+            }
+            swap(unassigned, next_unassigned);
+        }
+        if (eps == 1) break;
+        eps = max(1LL, eps / 6);
+    }
+    return vector<int>(obj_of.begin(), obj_of.begin() + nrows);
+}
+
+struct BatchStats {
+    int batches = 0;
+    double total_us = 0, max_us = 0;
+    long long weighted_cost = 0;
+};
+
+// Solve one window. Available ambulances used by the batch are marked busy.
+void dispatch_batch(const vector<Incident> &batch, vector<Ambulance> &ambulances, int K, int threads,
+                    long assigned_time, vector<Assignment> &assignments, BatchStats &stats) {
+    auto t0 = chrono::steady_clock::now();
+    vector<int> avail;
+    for (size_t i = 0; i < ambulances.size(); ++i) if (ambulances[i].available) avail.push_back((int)i);
+    auto cand = build_candidates(batch, ambulances, avail, K, threads);
+
+    // Compact the candidate ambulances into columns [0, namb); column namb + i is incident i unserved
+    unordered_map<int,int> col_of_amb;
+    vector<int> amb_of_col;
+    int m = batch.size();
+    vector<vector<pair<int,long long>>> adj(m);
+    for (int i = 0; i < m; ++i) {
+        for (auto &e : cand[i]) {
+            auto it = col_of_amb.find(e.amb);
+            if (it == col_of_amb.end()) {
+                it = col_of_amb.emplace(e.amb, (int)amb_of_col.size()).first;
+                amb_of_col.push_back(e.amb);
+            }
+            adj[i].push_back({it->second, e.cost});
+        }
+    }
+    int namb = amb_of_col.size();
+    for (int i = 0; i < m; ++i) adj[i].push_back({namb + i, batch[i].severity * UNSERVED_COST_PER_SEVERITY});
+
+    vector<int> col = m <= JV_MAX_BATCH ? solve_sparse_sap(adj, namb + m)
+                                        : solve_sparse_auction(adj, namb + m, namb, threads);
+
+    for (int i = 0; i < m; ++i) {
+        Assignment a;
+        a.incident_id = batch[i].id;
+        a.assigned_time = assigned_time;
+        if (col[i] < namb) {
+            int amb = amb_of_col[col[i]];
+            ambulances[amb].available = false; // mark busy (for this demo we never free)
+            a.ambulance_id = ambulances[amb].id;
+            a.distance = euclidDist(batch[i], ambulances[amb]);
+            stats.weighted_cost += llround(batch[i].severity * a.distance);
+        } else {
+            a.ambulance_id = "NONE";
+            a.distance = -1.0;
+            stats.weighted_cost += batch[i].severity * UNSERVED_COST_PER_SEVERITY;
+        }
+        assignments.push_back(a);
+    }
+    double us = chrono::duration<double, micro>(chrono::steady_clock::now() - t0).count();
+    stats.batches++;
+    stats.total_us += us;
+    stats.max_us = max(stats.max_us, us);
+}
+
 int main(int argc, char** argv) {
     ios::sync_with_stdio(false);
     cin.tie(nullptr);
     if (argc < 2) {
-        cerr << "Usage: " << argv[0] << " incidents.csv\n";
+        cerr << "Usage: " << argv[0] << " incidents.csv [--batch WINDOW_SECONDS] [--k K] [--threads T]\n";
         return 1;
     }
 
     string incidents_file = argv[1];
+    long batch_window = 0; // 0 = greedy priority dispatch
+    int K = 8;
+    int threads = max(1u, thread::hardware_concurrency());
+    for (int i = 2; i < argc; ++i) {
+        string arg = argv[i];
+        if (arg == "--batch" && i + 1 < argc) batch_window = stol(argv[++i]);
+        else if (arg == "--k" && i + 1 < argc) K = max(1, stoi(argv[++i]));
+        else if (arg == "--threads" && i + 1 < argc) threads = max(1, stoi(argv[++i]));
+    }
 
     // 1) Read incidents CSV
     vector<Incident> incidents;
@@ -99,13 +355,37 @@ int main(int argc, char** argv) {
         cout << "Generated " << ambulances.size() << " ambulances\n";
     }
 
+    vector<Assignment> assignments;
+    if (batch_window > 0) {
+        // 3-4) Batched dispatch: accumulate incidents for batch_window seconds, then solve the
+        // window's severity-weighted assignment in one go
+        sort(incidents.begin(), incidents.end(), [](const Incident &a, const Incident &b) {
+            return a.timestamp < b.timestamp;
+        });
+        assignments.reserve(incidents.size());
+        BatchStats stats;
+        size_t start = 0;
+        while (start < incidents.size()) {
+            long window_end = incidents[start].timestamp + batch_window;
+            size_t end = start;
+            while (end < incidents.size() && incidents[end].timestamp < window_end) ++end;
+            vector<Incident> batch(incidents.begin() + start, incidents.begin() + end);
+            dispatch_batch(batch, ambulances, K, threads, batch.back().timestamp, assignments, stats);
+            start = end;
+        }
+        cout << "Batches: " << stats.batches << " (window " << batch_window << "s, K=" << K
+             << ", threads=" << threads << ")\n";
+        cout << "Solve time per batch: mean " << stats.total_us / max(1, stats.batches)
+             << " us, max " << stats.max_us << " us\n";
+        cout << "Severity-weighted cost (unserved penalised): " << stats.weighted_cost << "\n";
+    }
+
     // 3) Build priority queue of incidents
     priority_queue<Incident, vector<Incident>, IncidentComparator> pq;
-    for (auto &ins : incidents) pq.push(ins);
+    if (batch_window == 0) for (auto &ins : incidents) pq.push(ins);
 
     // 4) Dispatch loop: pop highest-priority incident and find nearest available ambulance
-    vector<Assignment> assignments;
-    assignments.reserve(min((size_t)ambulances.size(), pq.size()));
+    if (batch_window == 0) assignments.reserve(min((size_t)ambulances.size(), pq.size()));
 
     while (!pq.empty()) {
         Incident ins = pq.top(); pq.pop();
@@ -1,7 +1,22 @@
 // tsp_dp.cpp
-// Compile: g++ -std=c++17 -O2 -o tsp_dp tsp_dp.cpp
-// Usage: ./tsp_dp /mnt/data/dumpsters.csv [K] [base_x] [base_y]
+// Compile: g++ -std=c++17 -O2 -pthread -o tsp_dp tsp_dp.cpp
+// Usage: ./tsp_dp /mnt/data/dumpsters.csv [K] [base_x] [base_y] [--threads T] [--heuristic]
+//                 [--cvrp TRUCKS CAPACITY]
 // Example: ./tsp_dp /mnt/data/dumpsters.csv 16 5000 5000
+//          ./tsp_dp /mnt/data/dumpsters.csv 0 5000 5000 --heuristic   (K=0: every dumpster)
+//          ./tsp_dp /mnt/data/dumpsters.csv 0 5000 5000 --cvrp 12 90     (12 trucks, 90 dumpsters each)
+//
+// Held-Karp DP layout: dp(mask,last) is only stored for last in mask, so row `mask` holds
+// popcount(mask) floats (one per set bit, in bit order) at offset[mask]. That is
+// K*2^(K-1) floats plus a 2^K uint32 offset table, ~870MB at K=24. No parent table:
+// the route is recovered by re-evaluating the recurrence on the way back. Masks are
+// processed one popcount layer at a time; a layer only reads the previous one, so each
+// layer is split across threads.
+//
+// --heuristic drops the K limit (K defaults to every dumpster): nearest-neighbour construction, then 2-opt and Or-opt
+// local search over each stop's nearest neighbours with don't-look bits.
+// --cvrp plans at most one route per truck instead of a single tour (see CVRP below) and
+// writes cvrp_routes.csv; if the routes cannot fit in TRUCKS it exits non-zero without one.
 
 #include <bits/stdc++.h>
 using namespace std;
@@ -10,18 +25,415 @@ double euclid(double x1,double y1,double x2,double y2){
     double dx=x1-x2, dy=y1-y2; return sqrt(dx*dx+dy*dy);
 }
 
+const int MAX_EXACT_K = 24;
+
+// Masks with `bits` set bits in increasing numeric (colex) order: the r-th one.
+uint32_t unrank_colex(uint64_t r, int bits, const vector<vector<uint64_t>> &C){
+    uint32_t mask = 0;
+    for(int k=bits; k>=1; --k){
+        int b = k-1;
+        while(C[b+1][k] <= r) ++b;
+        r -= C[b][k];
+        mask |= 1u<<b;
+    }
+    return mask;
+}
+
+// Next mask with the same popcount (Gosper's hack)
+inline uint32_t next_same_popcount(uint32_t v){
+    uint32_t t = v | (v-1);
+    return (t+1) | (((~t & -~t) - 1) >> (__builtin_ctz(v)+1));
+}
+
+// Exact TSP from base over K points. d is K*K row-major, d0[i] = base->i. Returns visiting order.
+vector<int> held_karp(int K, const vector<float> &d, const vector<float> &d0, int threads){
+    uint32_t FULL = 1u<<K;
+    vector<uint32_t> offset(FULL);
+    uint64_t total = 0;
+    for(uint32_t mask=0; mask<FULL; ++mask){ offset[mask] = (uint32_t)total; total += __builtin_popcount(mask); }
+    vector<float> dp(total);
+    vector<vector<uint64_t>> C(K+2, vector<uint64_t>(K+2, 0));
+    for(int n=0;n<=K+1;n++){ C[n][0]=1; for(int k=1;k<=n;k++) C[n][k]=C[n-1][k-1]+C[n-1][k]; }
+
+    // dp(mask,last) = min over p in mask\{last} of dp(mask\{last}, p) + d[p][last]
+    auto solve_mask = [&](uint32_t mask){
+        float *row = &dp[offset[mask]];
+        for(uint32_t m=mask; m; m&=m-1){
+            int last = __builtin_ctz(m);
+            uint32_t prev = mask ^ (1u<<last);
+            float best;
+            if(!prev) best = d0[last];
+            else {
+                const float *prow = &dp[offset[prev]];
+                const float *dl = &d[(size_t)last*K]; // d is symmetric: d[p][last] == d[last][p]
+                best = numeric_limits<float>::infinity();
+                int k = 0;
+                for(uint32_t pm=prev; pm; pm&=pm-1, ++k){
+                    float cand = prow[k] + dl[__builtin_ctz(pm)];
+                    best = cand < best ? cand : best;
+                }
+            }
+            *row++ = best;
+        }
+    };
+    for(int s=1; s<=K; ++s){
+        uint64_t count = C[K][s];
+        int t = (int)min<uint64_t>(threads, max<uint64_t>(1, count/4096));
+        vector<thread> pool;
+        for(int ti=0; ti<t; ++ti){
+            uint64_t lo = count*ti/t, hi = count*(ti+1)/t;
+            auto work = [&, lo, hi, s](){
+                uint32_t mask = unrank_colex(lo, s, C);
+                for(uint64_t r=lo; r<hi; ++r){
+                    solve_mask(mask);
+                    if(r+1<hi) mask = next_same_popcount(mask);
+                }
+            };
+            if(t==1) work(); else pool.emplace_back(work);
+        }
+        for(auto &th : pool) th.join();
+    }
+
+    // Close the tour, then walk back: the predecessor is the p whose term reproduces dp(mask,last)
+    auto at = [&](uint32_t mask, int last){ return dp[offset[mask] + __builtin_popcount(mask & ((1u<<last)-1))]; };
+    uint32_t mask = FULL-1;
+    int last = -1; float best = numeric_limits<float>::infinity();
+    for(int i=0;i<K;i++){ float c = at(mask,i) + d0[i]; if(c < best){ best = c; last = i; } }
+    vector<int> order;
+    while(true){
+        order.push_back(last);
+        uint32_t prev = mask ^ (1u<<last);
+        if(!prev) break;
+        float target = at(mask,last);
+        int p = -1;
+        for(uint32_t pm=prev; pm; pm&=pm-1){
+            int q = __builtin_ctz(pm);
+            if(at(prev,q) + d[(size_t)last*K+q] == target){ p = q; break; }
+        }
+        mask = prev; last = p;
+    }
+    reverse(order.begin(), order.end());
+    return order;
+}
+
+// ---------------- Heuristic tour (large K) ----------------
+const int NEIGHBOURS = 10;
+
+// k nearest points of every point, closest first
+vector<vector<int>> nearest_neighbours(const vector<Dump> &p, int k){
+    int n = (int)p.size();
+    k = min(k, n-1);
+    vector<vector<int>> neigh(n);
+    vector<pair<double,int>> tmp;
+    for(int i=0;i<n;i++){
+        tmp.clear();
+        for(int j=0;j<n;j++) if(j!=i) tmp.push_back({euclid(p[i].x,p[i].y,p[j].x,p[j].y), j});
+        partial_sort(tmp.begin(), tmp.begin()+k, tmp.end());
+        for(int j=0;j<k;j++) neigh[i].push_back(tmp[j].second);
+    }
+    return neigh;
+}
+
+// Run fn(begin,end) over [0,n) split into one contiguous chunk per thread
+template<class F>
+void parallel_for(int n, int threads, F fn){
+    if(threads <= 1 || n < 2){ fn(0, n); return; }
+    int t = min(threads, n), chunk = (n + t - 1) / t;
+    vector<thread> pool;
+    for(int b=0; b<n; b+=chunk) pool.emplace_back(fn, b, min(n, b+chunk));
+    for(auto &th : pool) th.join();
+}
+
+struct LocalSearch {
+    const vector<Dump> &p;
+    int n;
+    vector<int> tour, pos;
+    vector<vector<int>> neigh;   // NEIGHBOURS nearest stops, closest first
+
+    LocalSearch(const vector<Dump> &pts): p(pts), n((int)pts.size()), pos(pts.size()),
+        neigh(nearest_neighbours(pts, NEIGHBOURS)) {}
+    double D(int a,int b) const { return euclid(p[a].x,p[a].y,p[b].x,p[b].y); }
+    int succ(int c) const { return tour[pos[c]+1==n ? 0 : pos[c]+1]; }
+    int pred(int c) const { return tour[pos[c]==0 ? n-1 : pos[c]-1]; }
+
+    // Nearest unvisited stop, taken from the neighbour list when possible
+    void build_nearest_neighbour(int start){
+        vector<char> used(n,0);
+        tour.clear();
+        int cur = start;
+        for(int step=0; step<n; ++step){
+            used[cur]=1; pos[cur]=(int)tour.size(); tour.push_back(cur);
+            int nxt=-1;
+            for(int c : neigh[cur]) if(!used[c]){ nxt=c; break; }
+            if(nxt<0){
+                double bd=numeric_limits<double>::infinity();
+                for(int c=0;c<n;c++) if(!used[c]){ double d=D(cur,c); if(d<bd){ bd=d; nxt=c; } }
+            }
+            if(nxt<0) break;
+            cur=nxt;
+        }
+    }
+
+    // Reverse tour positions i..j (cyclic). Reversing the complement gives the same cycle,
+    // so always flip the shorter side.
+    void reverse_path(int i,int j){
+        int len = (j-i+n)%n + 1;
+        if(2*len > n){ int ni=(j+1)%n, nj=(i-1+n)%n; i=ni; j=nj; len=n-len; }
+        for(int s=0; s<len/2; ++s){
+            swap(tour[i],tour[j]); pos[tour[i]]=i; pos[tour[j]]=j;
+            i = i+1==n ? 0 : i+1; j = j==0 ? n-1 : j-1;
+        }
+    }
+    // Replace edges {a,b},{c,d} (same direction: b after a, d after c) by {a,c},{b,d}
+    void two_opt_move(int a,int b,int c,int d){
+        if(succ(a)==b) reverse_path(pos[b],pos[c]);
+        else reverse_path(pos[a],pos[d]);
+    }
+
+    bool try_2opt(int a, vector<int> &touched){
+        for(int dir=0; dir<2; ++dir){
+            int b = dir==0 ? succ(a) : pred(a);
+            double dab = D(a,b);
+            for(int c : neigh[a]){
+                double g1 = dab - D(a,c);
+                if(g1 <= 1e-9) break;
+                int d = dir==0 ? succ(c) : pred(c);
+                if(c==b || d==a) continue;
+                if(g1 + D(c,d) - D(b,d) > 1e-9){
+                    if(dir==0) two_opt_move(a,b,c,d); else two_opt_move(b,a,d,c);
+                    touched.insert(touched.end(), {a,b,c,d});
+                    return true;
+                }
+            }
+        }
+        return false;
+    }
+
+    // Move the segment of 1..3 stops starting at a between a neighbouring edge (c,e),
+    // in either orientation
+    bool try_oropt(int a, vector<int> &touched){
+        for(int L=1; L<=3 && L+3<=n; ++L){
+            int s1=a, sL=a;
+            for(int k=1;k<L;k++) sL=succ(sL);
+            int pr=pred(s1), nx=succ(sL);
+            double g = D(pr,s1) + D(sL,nx) - D(pr,nx);
+            if(g <= 1e-9) continue;
+            for(int end=0; end<2; ++end){
+                for(int c : neigh[end==0 ? s1 : sL]){
+                    for(int side=0; side<2; ++side){
+                        int x = side==0 ? c : pred(c), e = succ(x);
+                        // edge (x,e) must lie outside the segment and not touch pr
+                        bool inside=false;
+                        for(int k=0, s=s1; k<L; k++, s=succ(s)) if(s==x || s==e){ inside=true; break; }
+                        if(inside || x==pr || e==pr) continue;
+                        double fwd = D(x,s1) + D(sL,e) - D(x,e);
+                        double rev = D(x,sL) + D(s1,e) - D(x,e);
+                        if(g - min(fwd,rev) <= 1e-9) continue;
+                        // three 2-opt moves: reversed insertion, then flip the segment if needed
+                        two_opt_move(pr,s1,x,e);
+                        if(x!=nx) two_opt_move(pr,x,nx,sL);
+                        if(fwd < rev) two_opt_move(x,sL,s1,e);
+                        touched.insert(touched.end(), {pr,nx,s1,sL,x,e});
+                        return true;
+                    }
+                }
+            }
+        }
+        return false;
+    }
+
+    // Don't-look bits: only stops whose tour edges changed are re-examined
+    void optimize(){
+        deque<int> active;
+        vector<char> queued(n,1);
+        for(int c : tour) active.push_back(c);
+        vector<int> touched;
+        while(!active.empty()){
+            int a = active.front(); active.pop_front(); queued[a]=0;
+            touched.clear();
+            if(try_2opt(a,touched) || try_oropt(a,touched)){
+                for(int c : touched) if(!queued[c]){ queued[c]=1; active.push_back(c); }
+            }
+        }
+    }
+};
+
+// ---------------- Multi-truck CVRP ----------------
+// Every dumpster is one unit of load (the CSV carries no fill levels); a truck holds
+// `capacity` dumpsters. Clarke-Wright savings over neighbour pairs builds the routes,
+// the shortest routes are dissolved into the others until the fleet size fits, then
+// rounds of local search: 2-opt inside each route, and the best relocate / exchange
+// move for every pair of routes, evaluated in parallel and applied greedily on disjoint
+// route pairs.
+const int SAVINGS_NEIGHBOURS = 30;
+
+struct CVRP {
+    const vector<Dump> &p;          // p[0] is the base
+    int capacity;
+    vector<vector<int>> routes;     // customer indices into p, base implicit at both ends
+
+    CVRP(const vector<Dump> &pts, int cap): p(pts), capacity(cap) {}
+    double D(int a,int b) const { return euclid(p[a].x,p[a].y,p[b].x,p[b].y); }
+    double route_length(const vector<int> &r) const {
+        double len = 0; int prev = 0;
+        for(int c : r){ len += D(prev,c); prev = c; }
+        return len + D(prev,0);
+    }
+
+    void clarke_wright(){
+        int n = (int)p.size();
+        auto neigh = nearest_neighbours(p, SAVINGS_NEIGHBOURS);
+        vector<tuple<double,int,int>> savings;
+        for(int i=1;i<n;i++) for(int j : neigh[i]){
+            if(j==0) continue;
+            int a=min(i,j), b=max(i,j);
+            savings.push_back({D(0,a)+D(0,b)-D(a,b), a, b});
+        }
+        sort(savings.begin(), savings.end(), greater<>());
+        savings.erase(unique(savings.begin(), savings.end()), savings.end());
+        routes.assign(n, {});
+        vector<int> rid(n);
+        for(int i=1;i<n;i++){ routes[i] = {i}; rid[i] = i; }
+        for(auto &[s,i,j] : savings){
+            if(s <= 0) break;
+            int ri = rid[i], rj = rid[j];
+            if(ri==rj) continue;
+            auto &A = routes[ri], &B = routes[rj];
+            if((int)(A.size()+B.size()) > capacity) continue;
+            if((A.front()!=i && A.back()!=i) || (B.front()!=j && B.back()!=j)) continue;
+            if(A.back()!=i) reverse(A.begin(), A.end());
+            if(B.front()!=j) reverse(B.begin(), B.end());
+            for(int c : B) rid[c] = ri;
+            A.insert(A.end(), B.begin(), B.end());
+            B.clear();
+        }
+        routes.erase(remove_if(routes.begin(), routes.end(), [](const vector<int> &r){ return r.empty(); }), routes.end());
+    }
+
+    // Dissolve the routes with the fewest dumpsters until at most max_routes remain,
+    // cheapest-inserting each orphaned dumpster into a route with spare capacity. With unit
+    // loads this always succeeds when max_routes*capacity covers every dumpster.
+    void eliminate_routes(int max_routes){
+        while((int)routes.size() > max_routes){
+            auto smallest = min_element(routes.begin(), routes.end(),
+                [](const vector<int> &a, const vector<int> &b){ return a.size() < b.size(); });
+            vector<int> orphans = std::move(*smallest);
+            routes.erase(smallest);
+            vector<int> stranded;
+            for(int c : orphans){
+                double best = numeric_limits<double>::infinity(); int br = -1, bj = -1;
+                for(int r=0; r<(int)routes.size(); ++r){
+                    const auto &R = routes[r];
+                    if((int)R.size() >= capacity) continue;
+                    for(int j=0;j<=(int)R.size();j++){
+                        int u = j ? R[j-1] : 0, v = j<(int)R.size() ? R[j] : 0;
+                        double cost = D(u,c) + D(c,v) - D(u,v);
+                        if(cost < best){ best = cost; br = r; bj = j; }
+                    }
+                }
+                if(br < 0) stranded.push_back(c);
+                else routes[br].insert(routes[br].begin()+bj, c);
+            }
+            if(!stranded.empty()){ routes.push_back(std::move(stranded)); return; }
+        }
+    }
+
+    // First-improvement 2-opt within one route (base included as both ends)
+    void two_opt_route(vector<int> &r) const {
+        int m = (int)r.size();
+        auto at = [&](int i){ return (i<0 || i>=m) ? 0 : r[i]; };
+        bool improved = true;
+        while(improved){
+            improved = false;
+            for(int i=0;i<m;i++) for(int j=i+1;j<m;j++){
+                double delta = D(at(i-1),r[j]) + D(r[i],at(j+1)) - D(at(i-1),r[i]) - D(r[j],at(j+1));
+                if(delta < -1e-9){ reverse(r.begin()+i, r.begin()+j+1); improved = true; }
+            }
+        }
+    }
+
+    struct Move { double gain = 0; int type = -1, r1 = -1, r2 = -1, i = -1, j = -1; };
+    // type 0: relocate routes[r1][i] into routes[r2] before position j; type 1: exchange
+    // routes[r1][i] with routes[r2][j]
+    Move best_move(int r1, int r2) const {
+        const auto &A = routes[r1], &B = routes[r2];
+        auto atA = [&](int i){ return (i<0 || i>=(int)A.size()) ? 0 : A[i]; };
+        auto atB = [&](int j){ return (j<0 || j>=(int)B.size()) ? 0 : B[j]; };
+        Move best;
+        for(int i=0;i<(int)A.size();i++){
+            int pa = atA(i-1), a = A[i], na = atA(i+1);
+            double remove_gain = D(pa,a) + D(a,na) - D(pa,na);
+            if((int)B.size() < capacity){
+                for(int j=0;j<=(int)B.size();j++){
+                    int u = atB(j-1), v = atB(j);
+                    double gain = remove_gain - (D(u,a) + D(a,v) - D(u,v));
+                    if(gain > best.gain) best = {gain, 0, r1, r2, i, j};
+                }
+            }
+            if(r1 < r2){
+                for(int j=0;j<(int)B.size();j++){
+                    int pb = atB(j-1), b = B[j], nb = atB(j+1);
+                    double gain = D(pa,a) + D(a,na) + D(pb,b) + D(b,nb)
+                                - D(pa,b) - D(b,na) - D(pb,a) - D(a,nb);
+                    if(gain > best.gain) best = {gain, 1, r1, r2, i, j};
+                }
+            }
+        }
+        return best;
+    }
+
+    void local_search(int threads){
+        while(true){
+            parallel_for((int)routes.size(), threads, [&](int b, int e){
+                for(int r=b; r<e; ++r) two_opt_route(routes[r]);
+            });
+            int R = (int)routes.size();
+            vector<Move> moves((size_t)R*R);
+            parallel_for(R*R, threads, [&](int b, int e){
+                for(int k=b; k<e; ++k) if(k/R != k%R) moves[k] = best_move(k/R, k%R);
+            });
+            sort(moves.begin(), moves.end(), [](const Move &x, const Move &y){ return x.gain > y.gain; });
+            vector<char> used(R, 0);
+            int applied = 0;
+            for(auto &mv : moves){
+                if(mv.gain <= 1e-9) break;
+                if(used[mv.r1] || used[mv.r2]) continue;
+                used[mv.r1] = used[mv.r2] = 1;
+                auto &A = routes[mv.r1], &B = routes[mv.r2];
+                if(mv.type == 0){ B.insert(B.begin()+mv.j, A[mv.i]); A.erase(A.begin()+mv.i); }
+                else swap(A[mv.i], B[mv.j]);
+                ++applied;
+            }
+            if(!applied) break;
+        }
+        routes.erase(remove_if(routes.begin(), routes.end(), [](const vector<int> &r){ return r.empty(); }), routes.end());
+    }
+};
+
 int main(int argc, char** argv){
     ios::sync_with_stdio(false);
     cin.tie(nullptr);
     if(argc < 2){
-        cerr<<"Usage: "<<argv[0]<<" dumpsters.csv [K=16] [base_x=5000] [base_y=5000]\n";
+        cerr<<"Usage: "<<argv[0]<<" dumpsters.csv [K=16] [base_x=5000] [base_y=5000] [--threads T] [--heuristic] [--cvrp TRUCKS CAPACITY]\n";
         return 1;
     }
     string csv = argv[1];
     int K = 16;
     double base_x = 5000.0, base_y = 5000.0;
-    if(argc >= 3) K = stoi(argv[2]);
-    if(argc >= 5){ base_x = stod(argv[3]); base_y = stod(argv[4]); }
+    int threads = max(1u, thread::hardware_concurrency());
+    bool heuristic = false;
+    int trucks = 0, capacity = 0; // trucks > 0: CVRP mode
+    vector<string> pos;
+    for(int i=2;i<argc;i++){
+        string a = argv[i];
+        if(a=="--threads" && i+1<argc) threads = max(1, stoi(argv[++i]));
+        else if(a=="--heuristic") heuristic = true;
+        else if(a=="--cvrp" && i+2<argc){ trucks = stoi(argv[++i]); capacity = stoi(argv[++i]); }
+        else pos.push_back(a);
+    }
+    if(pos.size() >= 1) K = stoi(pos[0]);
+    else if(heuristic || trucks > 0) K = 0; // every dumpster
+    if(pos.size() >= 3){ base_x = stod(pos[1]); base_y = stod(pos[2]); }
 
     // Read all dumpsters
     vector<Dump> all;
@@ -53,7 +465,11 @@ int main(int argc, char** argv){
         dist_idx.push_back({d,i});
     }
     sort(dist_idx.begin(), dist_idx.end());
-    if(K > N_all) K = N_all;
+    if(K > N_all || ((heuristic || trucks > 0) && K <= 0)) K = N_all;
+    if(trucks > 0 && (capacity <= 0 || (long long)trucks*capacity < K)){
+        cerr<<trucks<<" trucks of capacity "<<capacity<<" cannot collect "<<K<<" dumpsters\n"; return 1;
+    }
+    if(!heuristic && trucks == 0 && K > MAX_EXACT_K){ cerr<<"K="<<K<<" too large for exact DP (max "<<MAX_EXACT_K<<")\n"; return 1; }
     vector<Dump> nodes; nodes.reserve(K+1);
     // Node 0 is base
     Dump base; base.id = "BASE"; base.x = base_x; base.y = base_y;
@@ -61,69 +477,68 @@ int main(int argc, char** argv){
     for(int i=0;i<K;i++){
         nodes.push_back(all[dist_idx[i].second]);
     }
-    cout<<"Solving exact TSP for K="<<K<<" nearest dumpsters (node count incl. base = "<<K+1<<")\n";
-
-    // Build distance matrix (size K+1)
-    int M = K+1;
-    vector<vector<double>> dist(M, vector<double>(M,0.0));
-    for(int i=0;i<M;i++) for(int j=0;j<M;j++)
-        dist[i][j] = euclid(nodes[i].x, nodes[i].y, nodes[j].x, nodes[j].y);
-
-    // DP: masks over K dumpsters (bits 0..K-1 correspond to nodes 1..K)
-    int FULL = 1<<K;
-    const double INF = 1e18;
-    // dp[mask][last] where last in 1..K; store parent for reconstruction
-    vector<vector<double>> dp(FULL, vector<double>(K+1, INF));
-    vector<vector<int>> parent(FULL, vector<int>(K+1, -1));
-
-    // Initialize
-    for(int i=1;i<=K;i++){
-        int mask = 1<<(i-1);
-        dp[mask][i] = dist[0][i]; // base -> i
-        parent[mask][i] = 0;
-    }
-
-    // Iterate masks
-    for(int mask=0; mask<FULL; ++mask){
-        for(int last=1; last<=K; ++last){
-            if(!(mask & (1<<(last-1)))) continue;
-            double cur = dp[mask][last];
-            if(cur >= INF) continue;
-            // Try to go to next
-            for(int nxt=1; nxt<=K; ++nxt){
-                if(mask & (1<<(nxt-1))) continue;
-                int nmask = mask | (1<<(nxt-1));
-                double cand = cur + dist[last][nxt];
-                if(cand < dp[nmask][nxt]){
-                    dp[nmask][nxt] = cand;
-                    parent[nmask][nxt] = last;
-                }
-            }
+    if(trucks > 0){
+        cout<<"CVRP for K="<<K<<" nearest dumpsters with "<<trucks<<" trucks of capacity "<<capacity<<"\n";
+        auto t0 = chrono::steady_clock::now();
+        CVRP vrp(nodes, capacity);
+        vrp.clarke_wright();
+        double cw_total = 0;
+        for(auto &r : vrp.routes) cw_total += vrp.route_length(r);
+        int cw_routes = (int)vrp.routes.size();
+        vrp.eliminate_routes(trucks);
+        vrp.local_search(threads);
+        cout<<"CVRP solve time: "<<chrono::duration<double,milli>(chrono::steady_clock::now()-t0).count()<<" ms\n";
+        if((int)vrp.routes.size() > trucks){
+            cerr<<"Plan needs "<<vrp.routes.size()<<" routes but only "<<trucks<<" trucks are available\n";
+            return 1;
+        }
+        double total = 0;
+        ofstream fout("cvrp_routes.csv");
+        fout<<"route,sequence,site_id,x,y\n";
+        for(size_t r=0; r<vrp.routes.size(); ++r){
+            auto &route = vrp.routes[r];
+            double len = vrp.route_length(route);
+            total += len;
+            cout<<"Truck "<<r+1<<": load="<<route.size()<<"/"<<capacity<<" distance="<<fixed<<setprecision(3)<<len<<"\n";
+            int seq = 0;
+            fout<<r+1<<","<<seq++<<","<<nodes[0].id<<","<<nodes[0].x<<","<<nodes[0].y<<"\n";
+            for(int idx : route) fout<<r+1<<","<<seq++<<","<<nodes[idx].id<<","<<nodes[idx].x<<","<<nodes[idx].y<<"\n";
+            fout<<r+1<<","<<seq<<","<<nodes[0].id<<","<<nodes[0].x<<","<<nodes[0].y<<"\n";
         }
+        fout.close();
+        cout<<"Savings construction distance: "<<fixed<<setprecision(6)<<cw_total<<" over "<<cw_routes<<" routes\n";
+        cout<<"Total distance after local search: "<<total<<" over "<<vrp.routes.size()<<" routes\n";
+        cout<<"Wrote cvrp_routes.csv.\n";
+        return 0;
     }
 
-    // Close tour: full mask
-    int fullmask = FULL - 1;
-    double best = INF; int lastBest = -1;
-    for(int last=1; last<=K; ++last){
-        double cand = dp[fullmask][last] + dist[last][0];
-        if(cand < best){ best = cand; lastBest = last; }
-    }
-    if(best >= INF){ cerr<<"No tour found\n"; return 1; }
+    vector<int> pathNodes; // indices into nodes (1..K), visit order between base start and end
+    if(heuristic){
+        cout<<"Heuristic tour (NN + 2-opt/Or-opt) for K="<<K<<" nearest dumpsters (node count incl. base = "<<K+1<<")\n";
+        auto t0 = chrono::steady_clock::now();
+        LocalSearch ls(nodes);
+        ls.build_nearest_neighbour(0);
+        ls.optimize();
+        int at = ls.pos[0];
+        for(int s=1; s<=K; ++s) pathNodes.push_back(ls.tour[(at+s)%(K+1)]);
+        cout<<"Heuristic solve time: "<<chrono::duration<double,milli>(chrono::steady_clock::now()-t0).count()<<" ms\n";
+    } else {
+        cout<<"Solving exact TSP for K="<<K<<" nearest dumpsters (node count incl. base = "<<K+1<<")\n";
+
+        // Build distance matrix over the K dumpsters (nodes 1..K) plus base distances
+        vector<float> dist((size_t)K*K), dist0(K);
+        for(int i=0;i<K;i++){
+            dist0[i] = (float)euclid(base_x, base_y, nodes[i+1].x, nodes[i+1].y);
+            for(int j=0;j<K;j++) dist[(size_t)i*K+j] = (float)euclid(nodes[i+1].x, nodes[i+1].y, nodes[j+1].x, nodes[j+1].y);
+        }
 
-    // Reconstruct path
-    vector<int> pathNodes; // indices into nodes (0..K), start at base, visit in order, return base
-    int curMask = fullmask;
-    int curLast = lastBest;
-    while(curLast != 0){
-        pathNodes.push_back(curLast);
-        int p = parent[curMask][curLast];
-        curMask ^= 1<<(curLast-1);
-        curLast = p;
+        if(K > 0) for(int i : held_karp(K, dist, dist0, threads)) pathNodes.push_back(i+1);
     }
-    reverse(pathNodes.begin(), pathNodes.end());
+    double best = 0; int prevNode = 0;
+    for(int idx : pathNodes){ best += euclid(nodes[prevNode].x, nodes[prevNode].y, nodes[idx].x, nodes[idx].y); prevNode = idx; }
+    best += euclid(nodes[prevNode].x, nodes[prevNode].y, nodes[0].x, nodes[0].y);
     // Output full route including base at start and end
-    cout<<"Optimal tour cost (approx): "<<fixed<<setprecision(6)<<best<<"\n";
+    cout<<(heuristic ? "Heuristic tour cost: " : "Optimal tour cost (approx): ")<<fixed<<setprecision(6)<<best<<"\n";
     cout<<"Route: BASE -> ";
     for(int idx : pathNodes) cout<<nodes[idx].id<<" -> ";
     cout<<"BASE\n";
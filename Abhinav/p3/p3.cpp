@@ -1,7 +1,25 @@
 // multi_source_bfs_expanded.cpp
 // Expanded and fully commented Multi-Source BFS implementation.
-// Compile with: g++ -std=c++17 -O2 -o multi_source_bfs_expanded multi_source_bfs_expanded.cpp
-// Usage: ./multi_source_bfs_expanded graph_with_stations.csv
+// Compile with: g++ -std=c++17 -O2 -pthread -o multi_source_bfs_expanded multi_source_bfs_expanded.cpp
+// Usage: ./multi_source_bfs_expanded graph_with_stations.csv [--bfs classic|do|parallel] [--threads T] [--verify]
+//                                   [--session] [--candidates FILE | --random-candidates COUNT SIZE]
+//                                   [--lanes 64|256]
+//   --bfs classic   : top-down deque BFS over adjacency lists (default)
+//   --bfs do        : direction-optimizing BFS over a CSR graph (single thread)
+//   --bfs parallel  : direction-optimizing BFS with each level split across threads
+//   --verify        : also run the classic BFS and check the distances match
+//   --session       : after the initial BFS, read what-if commands from stdin, one per line:
+//                       ADD_STATION u     open a station at node u
+//                       REMOVE_STATION u  close the station at node u
+//                       QUERY u           print distance and nearest station of node u
+//                     Each command only touches the nodes whose answer changes. The output
+//                     files are written from the final state at end of input.
+//   --candidates    : score many candidate station sets instead (see CANDIDATE SETS below);
+//                     FILE has header candidate_id,stations and stations separated by ';'
+//   --random-candidates : generate COUNT random sets of SIZE stations to score
+//   --lanes         : candidate sets per bit-parallel BFS pass (default 256)
+//                     Writes candidate_scores.csv with columns
+//                     candidate_id,stations,max_distance,mean_distance,unreachable
 //
 // Input CSV format (header required):
 // type,u,v
@@ -178,6 +196,422 @@ pair<vector<int>, vector<int>> multi_source_bfs(const vector<vector<int>> &adj,
     return {dist, origin};
 }
 
+// ----------------- CSR graph + direction-optimizing BFS ---------------------
+
+// Compressed sparse row copy of the adjacency lists: all neighbour lists live in one
+// contiguous array, so a BFS level streams through memory instead of chasing one heap
+// allocation per node. Node ids stay 1..n (index 0 unused) to match adj.
+struct CSRGraph {
+    int n = 0;
+    vector<int> offsets;   // neighbours of u are targets[offsets[u] .. offsets[u+1])
+    vector<int> targets;
+    int degree(int u) const { return offsets[u + 1] - offsets[u]; }
+};
+
+CSRGraph build_csr(const vector<vector<int>> &adj) {
+    CSRGraph g;
+    g.n = (int)adj.size() - 1;
+    g.offsets.assign(g.n + 2, 0);
+    for (int u = 1; u <= g.n; ++u) g.offsets[u + 1] = g.offsets[u] + (int)adj[u].size();
+    g.targets.resize(g.offsets[g.n + 1]);
+    for (int u = 1; u <= g.n; ++u) copy(adj[u].begin(), adj[u].end(), g.targets.begin() + g.offsets[u]);
+    return g;
+}
+
+// Run fn(begin, end) over [0, n) split into one contiguous chunk per thread.
+template <class F>
+void parallel_for(size_t n, int threads, F fn) {
+    if (threads <= 1 || n < 2) { fn((size_t)0, n); return; }
+    size_t t = min((size_t)threads, n);
+    size_t chunk = (n + t - 1) / t;
+    vector<thread> pool;
+    for (size_t b = 0; b < n; b += chunk) pool.emplace_back(fn, b, min(n, b + chunk));
+    for (auto &th : pool) th.join();
+}
+
+// Switching thresholds from Beamer et al., "Direction-Optimizing Breadth-First Search":
+// go bottom-up once the frontier's edges exceed 1/ALPHA of the unexplored edges, and
+// back to top-down once the frontier holds fewer than 1/BETA of all nodes.
+const long long DO_BFS_ALPHA = 14;
+const long long DO_BFS_BETA = 24;
+// A level with less work than this runs on one thread; spawning threads would cost more.
+const size_t DO_BFS_PARALLEL_MIN_WORK = 1 << 14;
+
+// Same contract as multi_source_bfs, on a CSR graph.
+// Top-down steps expand the frontier queue; with several threads each thread claims a
+// neighbour by compare-and-swap on dist[v] (-1 -> level + 1), so exactly one writer sets
+// origin[v]. Bottom-up steps let every unvisited node look for any neighbour in the
+// frontier bitmap; threads own disjoint 64-node words of the bitmap, so no atomics are
+// needed there. Distances always match the classic BFS; when two stations are equally
+// near a node, origin may name either of them.
+pair<vector<int>, vector<int>> multi_source_bfs_do(const CSRGraph &g, const vector<int> &stations, int threads) {
+    int n = g.n;
+    vector<int> dist(n + 1, -1);
+    vector<int> origin(n + 1, 0);
+    size_t words = (size_t)n / 64 + 1;                 // bit u of the bitmap is node u
+    vector<uint64_t> front_bits(words, 0), next_bits(words, 0);
+    vector<int> frontier, next;
+    mutex next_mu;
+
+    long long edges_frontier = 0;                      // sum of degrees in the frontier
+    long long edges_unexplored = (long long)g.targets.size();
+    for (int s : stations) {
+        if (s <= 0 || s > n) continue;
+        if (dist[s] == 0) continue; // duplicate station entry skip
+        dist[s] = 0;
+        origin[s] = s;
+        frontier.push_back(s);
+        edges_frontier += g.degree(s);
+    }
+    edges_unexplored -= edges_frontier;
+
+    bool bottom_up = false;
+    size_t frontier_size = frontier.size();
+    for (int level = 0; frontier_size > 0; ++level) {
+        // Pick the direction for this level, converting the frontier representation if needed
+        if (!bottom_up && edges_frontier > edges_unexplored / DO_BFS_ALPHA) {
+            fill(front_bits.begin(), front_bits.end(), 0);
+            for (int u : frontier) front_bits[u >> 6] |= 1ULL << (u & 63);
+            bottom_up = true;
+        } else if (bottom_up && frontier_size < (size_t)n / DO_BFS_BETA) {
+            frontier.clear();
+            for (size_t w = 0; w < words; ++w)
+                for (uint64_t bits = front_bits[w]; bits; bits &= bits - 1)
+                    frontier.push_back((int)(w * 64 + __builtin_ctzll(bits)));
+            bottom_up = false;
+        }
+
+        long long next_edges = 0;
+        size_t next_size = 0;
+        if (!bottom_up) {
+            next.clear();
+            int t = (size_t)edges_frontier >= DO_BFS_PARALLEL_MIN_WORK ? threads : 1;
+            parallel_for(frontier.size(), t, [&](size_t b, size_t e) {
+                vector<int> local;
+                long long local_edges = 0;
+                for (size_t k = b; k < e; ++k) {
+                    int u = frontier[k];
+                    for (int i = g.offsets[u]; i < g.offsets[u + 1]; ++i) {
+                        int v = g.targets[i];
+                        if (__atomic_load_n(&dist[v], __ATOMIC_RELAXED) != -1) continue;
+                        if (t > 1) {
+                            if (!__sync_bool_compare_and_swap(&dist[v], -1, level + 1)) continue;
+                        } else {
+                            dist[v] = level + 1;
+                        }
+                        origin[v] = origin[u];
+                        local.push_back(v);
+                        local_edges += g.degree(v);
+                    }
+                }
+                lock_guard<mutex> lk(next_mu);
+                next.insert(next.end(), local.begin(), local.end());
+                next_edges += local_edges;
+            });
+            swap(frontier, next);
+            next_size = frontier.size();
+        } else {
+            int t = (size_t)n >= DO_BFS_PARALLEL_MIN_WORK ? threads : 1;
+            parallel_for(words, t, [&](size_t wb, size_t we) {
+                size_t local_size = 0;
+                long long local_edges = 0;
+                for (size_t w = wb; w < we; ++w) {
+                    uint64_t bits = 0;
+                    int lo = max(1, (int)(w * 64)), hi = min(n, (int)(w * 64 + 63));
+                    for (int v = lo; v <= hi; ++v) {
+                        if (dist[v] != -1) continue;
+                        for (int i = g.offsets[v]; i < g.offsets[v + 1]; ++i) {
+                            int u = g.targets[i];
+                            if (front_bits[u >> 6] >> (u & 63) & 1) {
+                                dist[v] = level + 1;
+                                origin[v] = origin[u];
+                                bits |= 1ULL << (v & 63);
+                                ++local_size;
+                                local_edges += g.degree(v);
+                                break;
+                            }
+                        }
+                    }
+                    next_bits[w] = bits;
+                }
+                lock_guard<mutex> lk(next_mu);
+                next_size += local_size;
+                next_edges += local_edges;
+            });
+            swap(front_bits, next_bits);
+        }
+        frontier_size = next_size;
+        edges_frontier = next_edges;
+        edges_unexplored -= next_edges;
+    }
+    return {dist, origin};
+}
+
+// --------------------- Incremental station what-ifs ------------------------
+
+// Keeps dist/origin from a multi-source BFS up to date as stations are added or removed.
+//  - Adding station u can only shorten distances, so a BFS from u that only continues
+//    through nodes it strictly improves touches exactly the nodes that switch to u.
+//  - Removing station u only affects its Voronoi cell (nodes with origin == u): every
+//    other node keeps its own, still open, nearest station. The cell is cleared and
+//    refilled from its boundary: outside neighbours are seeds at their current distance,
+//    merged in distance order with the BFS queue so nodes are still settled in order.
+// Ties between equally near stations keep the existing origin.
+struct StationSession {
+    const vector<vector<int>> &adj;
+    vector<int> &dist;
+    vector<int> &origin;
+    vector<char> is_station;
+    vector<char> in_cell;      // scratch for remove_station, all zero between calls
+
+    StationSession(const vector<vector<int>> &adj_, vector<int> &dist_, vector<int> &origin_,
+                   const vector<int> &stations)
+        : adj(adj_), dist(dist_), origin(origin_), is_station(adj_.size(), 0), in_cell(adj_.size(), 0) {
+        for (int s : stations) if (s > 0 && s < (int)adj.size()) is_station[s] = 1;
+    }
+
+    int num_nodes() const { return (int)adj.size() - 1; }
+
+    // Returns the number of nodes whose distance changed (including u itself)
+    size_t add_station(int u) {
+        if (is_station[u]) return 0;
+        is_station[u] = 1;
+        dist[u] = 0;
+        origin[u] = u;
+        size_t changed = 1;
+        deque<int> q{u};
+        while (!q.empty()) {
+            int x = q.front();
+            q.pop_front();
+            for (int y : adj[x]) {
+                if (dist[y] != -1 && dist[y] <= dist[x] + 1) continue;
+                dist[y] = dist[x] + 1;
+                origin[y] = u;
+                q.push_back(y);
+                ++changed;
+            }
+        }
+        return changed;
+    }
+
+    // Returns the size of u's Voronoi cell, i.e. the number of nodes that were recomputed
+    size_t remove_station(int u) {
+        if (!is_station[u]) return 0;
+        is_station[u] = 0;
+
+        // 1) Collect the cell: every node's BFS parent shares its origin, so the cell is
+        //    connected through nodes with origin == u.
+        vector<int> cell{u};
+        in_cell[u] = 1;
+        for (size_t i = 0; i < cell.size(); ++i) {
+            for (int y : adj[cell[i]]) {
+                if (!in_cell[y] && origin[y] == u) { in_cell[y] = 1; cell.push_back(y); }
+            }
+        }
+
+        // 2) Boundary seeds: reachable neighbours outside the cell, by current distance
+        vector<pair<int,int>> seeds;
+        for (int x : cell) {
+            for (int y : adj[x]) if (!in_cell[y] && dist[y] >= 0) seeds.push_back({dist[y], y});
+        }
+        sort(seeds.begin(), seeds.end());
+        seeds.erase(unique(seeds.begin(), seeds.end()), seeds.end());
+        for (int x : cell) { dist[x] = -1; origin[x] = 0; }
+
+        // 3) Refill the cell: always expand the nearer of the next seed and the queue front
+        deque<int> q;
+        size_t next_seed = 0;
+        while (next_seed < seeds.size() || !q.empty()) {
+            int x;
+            if (q.empty() || (next_seed < seeds.size() && seeds[next_seed].first <= dist[q.front()])) {
+                x = seeds[next_seed++].second;
+            } else {
+                x = q.front();
+                q.pop_front();
+            }
+            for (int y : adj[x]) {
+                if (!in_cell[y] || dist[y] != -1) continue;
+                dist[y] = dist[x] + 1;
+                origin[y] = origin[x];
+                q.push_back(y);
+            }
+        }
+        for (int x : cell) in_cell[x] = 0;
+        return cell.size();
+    }
+};
+
+// Read session commands from `in` until EOF, printing one result line per command.
+void run_station_session(StationSession &session, istream &in) {
+    string line;
+    while (getline(in, line)) {
+        trim_inplace(line);
+        if (line.empty()) continue;
+        stringstream ss(line);
+        string cmd, arg;
+        ss >> cmd >> arg;
+        for (auto &ch : cmd) ch = (char)toupper((unsigned char)ch);
+        int u = safe_stoi(arg);
+        if (u <= 0 || u > session.num_nodes()) {
+            cout << "ERR invalid node '" << arg << "'\n";
+            continue;
+        }
+        auto t0 = chrono::steady_clock::now();
+        if (cmd == "ADD_STATION") {
+            if (session.is_station[u]) { cout << "ERR node " << u << " is already a station\n"; continue; }
+            size_t changed = session.add_station(u);
+            double us = chrono::duration<double, micro>(chrono::steady_clock::now() - t0).count();
+            cout << "OK ADD_STATION " << u << " changed=" << changed << " time_us=" << us << "\n";
+        } else if (cmd == "REMOVE_STATION") {
+            if (!session.is_station[u]) { cout << "ERR node " << u << " is not a station\n"; continue; }
+            size_t cell = session.remove_station(u);
+            double us = chrono::duration<double, micro>(chrono::steady_clock::now() - t0).count();
+            cout << "OK REMOVE_STATION " << u << " cell=" << cell << " time_us=" << us << "\n";
+        } else if (cmd == "QUERY") {
+            cout << "OK QUERY " << u << " distance=" << session.dist[u] << " nearest_station=" << session.origin[u] << "\n";
+        } else {
+            cout << "ERR unknown command '" << cmd << "'\n";
+        }
+        cout.flush();
+    }
+}
+
+// ------------------------ CANDIDATE SETS (bit-parallel) ---------------------
+
+// Station-placement search scores thousands of candidate station sets on one graph.
+// Instead of one BFS per set, a bit-parallel BFS runs 64*W of them at once: every node
+// holds W 64-bit words, and bit b of a word says "candidate b has reached this node".
+// One level is then a single pass over the graph:
+//     next[v] = (OR of frontier[u] over neighbours u) & ~visited[v]
+// so a pass costs (levels * edges) word operations for 64*W candidates together.
+// W = 4 gives 256 candidates per pass; the word loops are plain C++ that the compiler
+// maps onto 256-bit registers when built with -mavx2.
+
+struct CandidateScore {
+    int max_dist = 0;         // over reachable nodes
+    long long sum_dist = 0;   // over reachable nodes
+    int reached = 0;          // nodes with a finite distance
+};
+
+// Read candidate sets: header candidate_id,stations; stations are node ids separated by ';'
+bool read_candidates_csv(const string &filename, vector<string> &ids, vector<vector<int>> &sets, string &err) {
+    ifstream fin(filename);
+    if (!fin.is_open()) {
+        err = "Cannot open file: " + filename;
+        return false;
+    }
+    string line;
+    getline(fin, line); // header
+    int line_no = 1;
+    while (getline(fin, line)) {
+        ++line_no;
+        trim_inplace(line);
+        if (line.empty()) continue;
+        size_t comma = line.find(',');
+        if (comma == string::npos) {
+            cerr << "Warning: malformed candidate at line " << line_no << ". Skipping.\n";
+            continue;
+        }
+        string id = line.substr(0, comma);
+        trim_inplace(id);
+        vector<int> set;
+        stringstream ss(line.substr(comma + 1));
+        string tok;
+        while (getline(ss, tok, ';')) {
+            trim_inplace(tok);
+            if (tok.empty()) continue;
+            int s = safe_stoi(tok);
+            if (s <= 0) {
+                cerr << "Warning: invalid station id '" << tok << "' at line " << line_no << ". Ignoring it.\n";
+                continue;
+            }
+            set.push_back(s);
+        }
+        ids.push_back(id);
+        sets.push_back(set);
+    }
+    return true;
+}
+
+// Score candidates [first, first + count) with count <= 64 * W in one bit-parallel pass.
+template <int W>
+void bit_parallel_bfs_pass(const CSRGraph &g, const vector<vector<int>> &sets, size_t first, int count,
+                           vector<CandidateScore> &scores) {
+    using Lanes = array<uint64_t, W>;
+    int n = g.n;
+    vector<Lanes> visited(n + 1, Lanes{}), frontier(n + 1, Lanes{}), next(n + 1, Lanes{});
+    Lanes all{};   // bits of the candidates in this pass
+    for (int k = 0; k < count; ++k) all[k >> 6] |= 1ULL << (k & 63);
+
+    // Record newly reached (node, candidate) pairs at distance `level`
+    auto account = [&](const Lanes &fresh, int level) {
+        for (int w = 0; w < W; ++w) {
+            for (uint64_t bits = fresh[w]; bits; bits &= bits - 1) {
+                CandidateScore &sc = scores[first + w * 64 + __builtin_ctzll(bits)];
+                ++sc.reached;
+                sc.sum_dist += level;
+                sc.max_dist = level;   // levels only grow
+            }
+        }
+    };
+
+    // Level 0: the stations of every candidate
+    for (int k = 0; k < count; ++k) {
+        for (int s : sets[first + k]) {
+            if (s <= 0 || s > n) continue;
+            visited[s][k >> 6] |= 1ULL << (k & 63);
+        }
+    }
+    for (int v = 1; v <= n; ++v) {
+        frontier[v] = visited[v];
+        account(visited[v], 0);
+    }
+
+    for (int level = 1;; ++level) {
+        bool any = false;
+        for (int v = 1; v <= n; ++v) {
+            Lanes acc{};
+            bool open = false;
+            for (int w = 0; w < W; ++w) open |= (visited[v][w] != all[w]);
+            if (open) {
+                for (int i = g.offsets[v]; i < g.offsets[v + 1]; ++i) {
+                    const Lanes &f = frontier[g.targets[i]];
+                    for (int w = 0; w < W; ++w) acc[w] |= f[w];
+                }
+                for (int w = 0; w < W; ++w) {
+                    acc[w] &= ~visited[v][w];
+                    any |= acc[w] != 0;
+                }
+            }
+            next[v] = acc;
+        }
+        if (!any) break;
+        for (int v = 1; v <= n; ++v) {
+            for (int w = 0; w < W; ++w) visited[v][w] |= next[v][w];
+            account(next[v], level);
+        }
+        swap(frontier, next);
+    }
+}
+
+// Score every candidate set. Passes are independent, so they are spread across threads
+// (each thread allocates its own visited/frontier/next arrays).
+vector<CandidateScore> score_candidate_sets(const CSRGraph &g, const vector<vector<int>> &sets, int lanes,
+                                            int threads, size_t &passes) {
+    vector<CandidateScore> scores(sets.size());
+    size_t per_pass = lanes;
+    passes = (sets.size() + per_pass - 1) / per_pass;
+    parallel_for(passes, threads, [&](size_t pb, size_t pe) {
+        for (size_t p = pb; p < pe; ++p) {
+            size_t first = p * per_pass;
+            int count = (int)min(per_pass, sets.size() - first);
+            if (lanes == 256) bit_parallel_bfs_pass<4>(g, sets, first, count, scores);
+            else bit_parallel_bfs_pass<1>(g, sets, first, count, scores);
+        }
+    });
+    return scores;
+}
+
 // --------------------------- Main Program ---------------------------------
 
 int main(int argc, char** argv) {
@@ -186,10 +620,40 @@ int main(int argc, char** argv) {
 
     cout << "Multi-Source BFS (expanded implementation)\n";
     if (argc < 2) {
-        cerr << "Usage: " << argv[0] << " graph_with_stations.csv\n";
+        cerr << "Usage: " << argv[0] << " graph_with_stations.csv [--bfs classic|do|parallel] [--threads T] [--verify] [--session]"
+             << " [--candidates FILE | --random-candidates COUNT SIZE] [--lanes 64|256]\n";
         return 1;
     }
     string csv_file = argv[1];
+    string bfs_mode = "classic";
+    int threads = max(1u, thread::hardware_concurrency());
+    bool verify = false;
+    bool session_mode = false;
+    string candidates_file;
+    int random_candidates = 0, random_candidate_size = 0;
+    int lanes = 256;
+    for (int i = 2; i < argc; ++i) {
+        string arg = argv[i];
+        if (arg == "--bfs" && i + 1 < argc) bfs_mode = argv[++i];
+        else if (arg == "--threads" && i + 1 < argc) threads = max(1, safe_stoi(argv[++i]));
+        else if (arg == "--verify") verify = true;
+        else if (arg == "--session") session_mode = true;
+        else if (arg == "--candidates" && i + 1 < argc) candidates_file = argv[++i];
+        else if (arg == "--random-candidates" && i + 2 < argc) {
+            random_candidates = max(0, safe_stoi(argv[++i]));
+            random_candidate_size = max(1, safe_stoi(argv[++i]));
+        }
+        else if (arg == "--lanes" && i + 1 < argc) lanes = safe_stoi(argv[++i]);
+        else cerr << "Warning: ignoring unknown argument '" << arg << "'.\n";
+    }
+    if (bfs_mode != "classic" && bfs_mode != "do" && bfs_mode != "parallel") {
+        cerr << "Unknown --bfs mode '" << bfs_mode << "' (expected classic, do or parallel).\n";
+        return 1;
+    }
+    if (lanes != 64 && lanes != 256) {
+        cerr << "Unknown --lanes value (expected 64 or 256).\n";
+        return 1;
+    }
 
     // 1) Read CSV and build GraphData
     GraphData gd;
@@ -252,12 +716,117 @@ int main(int argc, char** argv) {
 
     cout << "Adjacency built. Effective nodes: 1.." << N << ".\n";
 
+    // 3b) Candidate-set scoring replaces the single BFS when requested
+    if (!candidates_file.empty() || random_candidates > 0) {
+        vector<string> cand_ids;
+        vector<vector<int>> cand_sets;
+        if (!candidates_file.empty()) {
+            if (!read_candidates_csv(candidates_file, cand_ids, cand_sets, err)) {
+                cerr << "Error reading candidates: " << err << "\n";
+                return 1;
+            }
+        } else {
+            mt19937 rng(12345);
+            uniform_int_distribution<int> pick(1, N);
+            for (int c = 0; c < random_candidates; ++c) {
+                cand_ids.push_back("RAND" + to_string(c + 1));
+                vector<int> set;
+                for (int k = 0; k < random_candidate_size; ++k) set.push_back(pick(rng));
+                cand_sets.push_back(set);
+            }
+        }
+        cout << "Scoring " << cand_sets.size() << " candidate station sets, " << lanes << " per pass ...\n";
+        CSRGraph g = build_csr(adj);
+        size_t passes = 0;
+        auto t0 = chrono::steady_clock::now();
+        vector<CandidateScore> scores = score_candidate_sets(g, cand_sets, lanes, threads, passes);
+        cout << "Scored in " << passes << " passes, "
+             << chrono::duration<double, milli>(chrono::steady_clock::now() - t0).count() << " ms.\n";
+
+        if (verify) {
+            // Cross-check the first pass worth of candidates against one classic BFS each
+            size_t checks = min(cand_sets.size(), (size_t)lanes);
+            for (size_t c = 0; c < checks; ++c) {
+                vector<int> d = multi_source_bfs(adj, cand_sets[c]).first;
+                CandidateScore ref;
+                for (int node = 1; node <= N; ++node) {
+                    if (d[node] < 0) continue;
+                    ++ref.reached;
+                    ref.sum_dist += d[node];
+                    ref.max_dist = max(ref.max_dist, d[node]);
+                }
+                if (ref.reached != scores[c].reached || ref.sum_dist != scores[c].sum_dist ||
+                    (ref.reached > 0 && ref.max_dist != scores[c].max_dist)) {
+                    cerr << "Verification FAILED for candidate " << cand_ids[c] << ".\n";
+                    return 1;
+                }
+            }
+            cout << "Verification passed for " << checks << " candidates.\n";
+        }
+
+        string scores_csv = "candidate_scores.csv";
+        ofstream fc(scores_csv);
+        if (!fc.is_open()) {
+            cerr << "Failed to open output file for writing: " << scores_csv << "\n";
+            return 1;
+        }
+        fc << "candidate_id,stations,max_distance,mean_distance,unreachable\n";
+        for (size_t c = 0; c < cand_sets.size(); ++c) {
+            const CandidateScore &sc = scores[c];
+            double mean = sc.reached ? (double)sc.sum_dist / sc.reached : 0.0;
+            fc << cand_ids[c] << "," << cand_sets[c].size() << "," << (sc.reached ? sc.max_dist : -1) << ","
+               << mean << "," << (N - sc.reached) << "\n";
+        }
+        fc.close();
+
+        // Best candidate: fewest unreachable nodes, then smallest max distance, then mean
+        size_t best = 0;
+        auto key = [&](size_t c) {
+            return make_tuple(N - scores[c].reached, scores[c].max_dist,
+                              scores[c].reached ? (double)scores[c].sum_dist / scores[c].reached : 0.0);
+        };
+        for (size_t c = 1; c < cand_sets.size(); ++c) if (key(c) < key(best)) best = c;
+        if (!cand_sets.empty()) {
+            cout << "Best candidate: " << cand_ids[best] << " (max distance " << scores[best].max_dist
+                 << ", mean " << get<2>(key(best)) << ", unreachable " << get<0>(key(best)) << ").\n";
+        }
+        cout << "Wrote " << cand_sets.size() << " rows to '" << scores_csv << "'.\n";
+        cout << "Done.\n";
+        return 0;
+    }
+
     // 4) Run multi-source BFS
-    cout << "Starting multi-source BFS from " << gd.stations.size() << " stations ...\n";
-    auto result = multi_source_bfs(adj, gd.stations);
+    cout << "Starting multi-source BFS (" << bfs_mode << ") from " << gd.stations.size() << " stations ...\n";
+    pair<vector<int>, vector<int>> result;
+    auto bfs_start = chrono::steady_clock::now();
+    if (bfs_mode == "classic") {
+        result = multi_source_bfs(adj, gd.stations);
+    } else {
+        CSRGraph g = build_csr(adj);
+        bfs_start = chrono::steady_clock::now(); // time the search only, not the CSR build
+        result = multi_source_bfs_do(g, gd.stations, bfs_mode == "parallel" ? threads : 1);
+    }
+    cout << "BFS took " << chrono::duration<double, milli>(chrono::steady_clock::now() - bfs_start).count() << " ms.\n";
     vector<int> dist = move(result.first);
     vector<int> origin = move(result.second);
 
+    if (verify && bfs_mode != "classic") {
+        vector<int> ref = multi_source_bfs(adj, gd.stations).first;
+        if (ref != dist) {
+            cerr << "Verification FAILED: distances differ from the classic BFS.\n";
+            return 1;
+        }
+        cout << "Verification passed: distances match the classic BFS.\n";
+    }
+
+    // 4b) Optional what-if session: ADD_STATION / REMOVE_STATION / QUERY from stdin
+    if (session_mode) {
+        cout << "Session ready. Commands: ADD_STATION u, REMOVE_STATION u, QUERY u.\n";
+        cout.flush();
+        StationSession session(adj, dist, origin, gd.stations);
+        run_station_session(session, cin);
+    }
+
     // 5) Basic statistics
     int reachable = 0;
     int unreachable = 0;
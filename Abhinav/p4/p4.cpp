@@ -1,18 +1,31 @@
 // knn_location_risk.cpp
 // K-Nearest Neighbors for classifying a location as Safe or Risky
-// Compile: g++ -std=c++17 -O2 -o knn_location_risk knn_location_risk.cpp
+// Compile: g++ -std=c++17 -O2 -pthread -o knn_location_risk knn_location_risk.cpp
 //
 // The program reads a CSV of historical reports with columns:
 // report_id,latitude,longitude,label,severity,timestamp
 //
 // Example usage:
 // ./knn_location_risk crime_reports.csv --mode bruteforce --k 7 --query 12.9716 77.5946
+// ./knn_location_risk crime_reports.csv --mode flatkd --k 7 --batch queries.csv --threads 8 --compare
+// ./knn_location_risk crime_reports.csv --mode flatkd --k 7 --build-raster risk.bin --raster-size 1024 1024
+// ./knn_location_risk crime_reports.csv --raster risk.bin --batch queries.csv --compare
+// ./knn_location_risk crime_reports.csv --mode dynamic --ttl 2592000   (then ADD / EXPIRE lines on stdin)
+//
+// Build with -mavx2 (or -march=native) to enable the AVX2 kernel of --mode simd.
 //
 // The program prints "Risky" or "Safe" for the query location and details.
 //
 // Author: generated by ChatGPT
 
 #include <bits/stdc++.h>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#if defined(__AVX2__)
+#include <immintrin.h>
+#endif
 using namespace std;
 
 // --------------------------- Utilities ------------------------------------
@@ -119,6 +132,89 @@ int majority_vote(const vector<Neighbor> &neighbors) {
     return (cntRisk * 2 >= (int)neighbors.size()) ? 1 : 0; // tie -> risky
 }
 
+// ------------------------ Vectorized brute-force KNN -----------------------
+// For small and medium datasets a tight linear scan beats any tree. Every point is stored
+// once as a unit vector (x, y, z) on the sphere in SoA arrays. For unit vectors P and Q the
+// chord length is |P - Q| = sqrt(2 - 2 P.Q) and the haversine distance is 2R asin(|P - Q|/2),
+// both monotone in the dot product, so the K nearest points by haversine are exactly the K
+// largest dot products: three multiplies and two adds per point, no trigonometry. Only the
+// K winners get haversine_distance_m for the reported distances.
+// The AVX2 path scores four points per step and leaves the vector loop only for lanes that
+// beat the current K-th best dot product, which after the first few blocks is rare. Builds
+// without AVX2 (and AVX-512 builds, which also define __AVX2__) share the same layout.
+
+// Datasets up to this size use SimdBruteForce in --mode auto, larger ones the flat KD-tree.
+// Measured crossover for K=7 on one core (AVX2 build) is between 600 and 1000 points.
+const size_t AUTO_BRUTEFORCE_MAX_POINTS = 768;
+
+struct SimdBruteForce {
+    const vector<Point> *data = nullptr;
+    vector<double> x, y, z;
+
+    void build(const vector<Point> &pts) {
+        data = &pts;
+        size_t n = pts.size();
+        x.resize(n); y.resize(n); z.resize(n);
+        for (size_t i = 0; i < n; ++i) {
+            double lat = deg2rad(pts[i].lat), lon = deg2rad(pts[i].lon);
+            x[i] = cos(lat) * cos(lon);
+            y[i] = cos(lat) * sin(lon);
+            z[i] = sin(lat);
+        }
+    }
+
+    vector<Neighbor> knn_query(double qlat, double qlon, int K) const {
+        vector<Neighbor> result;
+        int n = (int)x.size();
+        if (!data || n == 0 || K <= 0) return result;
+        K = min(K, n);
+        double la = deg2rad(qlat), lo = deg2rad(qlon);
+        double qx = cos(la) * cos(lo), qy = cos(la) * sin(lo), qz = sin(la);
+
+        // best[0..cnt) sorted by dot product, largest (nearest) first
+        vector<pair<double,int>> best(K);
+        int cnt = 0;
+        double thr = -numeric_limits<double>::infinity();   // dot needed to enter the top K
+        auto insert = [&](double dot, int idx) {
+            int j = cnt < K ? cnt++ : K - 1;
+            while (j > 0 && best[j - 1].first < dot) { best[j] = best[j - 1]; --j; }
+            best[j] = {dot, idx};
+            if (cnt == K) thr = best[K - 1].first;
+        };
+
+        int i = 0;
+#if defined(__AVX2__)
+        __m256d vqx = _mm256_set1_pd(qx), vqy = _mm256_set1_pd(qy), vqz = _mm256_set1_pd(qz);
+        for (; i + 4 <= n; i += 4) {
+            __m256d dot = _mm256_add_pd(_mm256_add_pd(_mm256_mul_pd(vqx, _mm256_loadu_pd(&x[i])),
+                                                      _mm256_mul_pd(vqy, _mm256_loadu_pd(&y[i]))),
+                                        _mm256_mul_pd(vqz, _mm256_loadu_pd(&z[i])));
+            int mask = _mm256_movemask_pd(_mm256_cmp_pd(dot, _mm256_set1_pd(thr), _CMP_GT_OQ));
+            if (!mask) continue;
+            alignas(32) double lanes[4];
+            _mm256_store_pd(lanes, dot);
+            for (; mask; mask &= mask - 1) {
+                int l = __builtin_ctz(mask);
+                if (lanes[l] > thr) insert(lanes[l], i + l);
+            }
+        }
+#endif
+        for (; i < n; ++i) {
+            double dot = qx * x[i] + qy * y[i] + qz * z[i];
+            if (dot > thr) insert(dot, i);
+        }
+
+        result.reserve(cnt);
+        for (int j = 0; j < cnt; ++j) {
+            const Point &p = (*data)[best[j].second];
+            result.push_back({haversine_distance_m(qlat, qlon, p.lat, p.lon), p.label, p.id});
+        }
+        // Rounding can swap near-equal neighbours; report in haversine order like the other modes
+        sort(result.begin(), result.end(), [](const Neighbor &a, const Neighbor &b){ return a.dist < b.dist; });
+        return result;
+    }
+};
+
 // --------------------------- KD-Tree (2D) ---------------------------------
 // Simple KD-tree implementation for 2D points (latitude, longitude).
 // This is a recursive median-splitting KD-tree; supports KNN search.
@@ -215,6 +311,325 @@ struct KDTree {
     }
 };
 
+// --------------------------- Flat KD-Tree (2D) ----------------------------
+// Same queries as KDTree, laid out for cache-friendly search:
+//  - points are reordered so every leaf bucket (at most FLAT_KD_LEAF_SIZE points) is a
+//    contiguous run of SoA arrays (lat/lon in radians, cos(lat) precomputed for haversine)
+//  - the tree is implicit and complete: node i has children 2i+1 and 2i+2, all leaves sit
+//    at the same depth, and internal nodes only store a split value and an axis
+//  - search is iterative with a small explicit stack, keeping the best K in a sorted array
+// Pruning uses the same conservative metres-per-degree bounds as KDTree, with the longitude
+// factor taken at the highest |latitude| in the data so it never over-estimates.
+
+const int FLAT_KD_LEAF_SIZE = 24;
+
+// Haversine on pre-converted inputs (radians, cosine of latitude); matches haversine_distance_m
+inline double haversine_rad_m(double lat1, double lon1, double cos_lat1, double lat2, double lon2, double cos_lat2) {
+    const double R = 6371000.0;
+    double s_lat = sin((lat2 - lat1) * 0.5);
+    double s_lon = sin((lon2 - lon1) * 0.5);
+    double a = s_lat * s_lat + cos_lat1 * cos_lat2 * s_lon * s_lon;
+    return R * 2.0 * atan2(sqrt(a), sqrt(max(0.0, 1.0 - a)));
+}
+
+struct FlatKDTree {
+    const vector<Point> *data = nullptr;
+    int depth = 0;                       // leaves are at this depth (root = 0)
+    vector<double> split;                // per internal node, in degrees
+    vector<uint8_t> axis;                // per internal node: 0 = lat, 1 = lon
+    vector<int> leaf_begin;              // leaf j covers [leaf_begin[j], leaf_begin[j+1])
+    vector<double> lat_rad, lon_rad, cos_lat;   // reordered points (SoA)
+    vector<long> timestamp;              // reordered, for expiry filtering
+    vector<int> perm;                    // reordered position -> index in data
+    double lon_m_per_deg = 111000.0;
+
+    void build(const vector<Point> &pts) {
+        data = &pts;
+        int n = (int)pts.size();
+        depth = 0;
+        while (((long long)FLAT_KD_LEAF_SIZE << depth) < n) ++depth;
+        int internal = (1 << depth) - 1;
+        split.assign(internal, 0.0);
+        axis.assign(internal, 0);
+        leaf_begin.assign((1 << depth) + 1, n);
+        perm.resize(n);
+        iota(perm.begin(), perm.end(), 0);
+        double max_abs_lat = 0.0;
+        for (const auto &p : pts) max_abs_lat = max(max_abs_lat, fabs(p.lat));
+        lon_m_per_deg = 111000.0 * cos(deg2rad(min(89.0, max_abs_lat)));
+        build_node(0, 0, n, 0);
+        leaf_begin[1 << depth] = n;
+        lat_rad.resize(n); lon_rad.resize(n); cos_lat.resize(n); timestamp.resize(n);
+        for (int i = 0; i < n; ++i) {
+            const Point &p = pts[perm[i]];
+            lat_rad[i] = deg2rad(p.lat);
+            lon_rad[i] = deg2rad(p.lon);
+            cos_lat[i] = cos(lat_rad[i]);
+            timestamp[i] = p.timestamp;
+        }
+    }
+
+    // Split [l, r) at its middle along the axis with the larger extent in metres
+    void build_node(int node, int l, int r, int level) {
+        if (level == depth) {
+            leaf_begin[node - ((1 << depth) - 1)] = l;
+            return;
+        }
+        const vector<Point> &pts = *data;
+        double lat_lo = 1e9, lat_hi = -1e9, lon_lo = 1e9, lon_hi = -1e9;
+        for (int i = l; i < r; ++i) {
+            const Point &p = pts[perm[i]];
+            lat_lo = min(lat_lo, p.lat); lat_hi = max(lat_hi, p.lat);
+            lon_lo = min(lon_lo, p.lon); lon_hi = max(lon_hi, p.lon);
+        }
+        int ax = ((lon_hi - lon_lo) * lon_m_per_deg > (lat_hi - lat_lo) * 111000.0) ? 1 : 0;
+        int m = l + (r - l) / 2;
+        auto coord = [&](int i) { return ax == 0 ? pts[i].lat : pts[i].lon; };
+        nth_element(perm.begin() + l, perm.begin() + m, perm.begin() + r,
+                    [&](int a, int b) { return coord(a) < coord(b); });
+        axis[node] = (uint8_t)ax;
+        split[node] = (m < r) ? coord(perm[m]) : 0.0;
+        build_node(2 * node + 1, l, m, level + 1);
+        build_node(2 * node + 2, m, r, level + 1);
+    }
+
+    // Merge this tree's points into best (ascending by distance, at most K entries), skipping
+    // reports older than min_ts. Several trees can share one best list, and each then only
+    // searches the parts that can still beat it.
+    void knn_accumulate(double qlat, double qlon, int K, long min_ts, vector<pair<double,const Point*>> &best) const {
+        if (!data || data->empty() || K <= 0) return;
+        double qlat_r = deg2rad(qlat), qlon_r = deg2rad(qlon), qcos = cos(qlat_r);
+        auto worst = [&]() { return (int)best.size() < K ? numeric_limits<double>::infinity() : best.back().first; };
+
+        // Stack of (node, lower bound on distance to anything under it)
+        pair<int,double> stack[64];
+        int sp = 0;
+        stack[sp++] = {0, 0.0};
+        int first_leaf = (1 << depth) - 1;
+        while (sp > 0) {
+            auto [node, bound] = stack[--sp];
+            if (bound >= worst()) continue;
+            // Descend to a leaf, pushing the far side of each split
+            while (node < first_leaf) {
+                double diff = (axis[node] == 0 ? qlat : qlon) - split[node];
+                double plane = fabs(diff) * (axis[node] == 0 ? 111000.0 : lon_m_per_deg);
+                int near_child = diff < 0 ? 2 * node + 1 : 2 * node + 2;
+                int far_child = diff < 0 ? 2 * node + 2 : 2 * node + 1;
+                stack[sp++] = {far_child, max(bound, plane)};
+                node = near_child;
+            }
+            int leaf = node - first_leaf;
+            for (int i = leaf_begin[leaf]; i < leaf_begin[leaf + 1]; ++i) {
+                if (timestamp[i] < min_ts) continue;
+                double d = haversine_rad_m(qlat_r, qlon_r, qcos, lat_rad[i], lon_rad[i], cos_lat[i]);
+                if (d >= worst()) continue;
+                if ((int)best.size() < K) best.emplace_back();
+                int j = (int)best.size() - 1;
+                while (j > 0 && best[j - 1].first > d) { best[j] = best[j - 1]; --j; }
+                best[j] = {d, &(*data)[perm[i]]};
+            }
+        }
+    }
+
+    vector<Neighbor> knn_query(double qlat, double qlon, int K) const {
+        vector<pair<double,const Point*>> best;
+        best.reserve(max(K, 0));
+        knn_accumulate(qlat, qlon, K, numeric_limits<long>::min(), best);
+        vector<Neighbor> result;
+        result.reserve(best.size());
+        for (auto &b : best) result.push_back({b.first, b.second->label, b.second->id});
+        return result;
+    }
+};
+
+// ------------------------ Dynamic KD index (live reports) -------------------
+// Reports keep arriving, so the index must take appends without a full rebuild. This is the
+// logarithmic method: new reports go to a small unsorted buffer; when it fills, the buffer
+// and the run of occupied levels 0..i-1 are merged into level i, which holds at most
+// DYNAMIC_BUFFER_SIZE * 2^i reports in a FlatKDTree. Each report is rebuilt O(log n) times
+// and a query searches the buffer plus O(log n) trees through one shared top-K list, so
+// later trees prune against what earlier ones found.
+// Expiry is by report timestamp: expired reports are skipped at query time, a level whose
+// newest report expired is dropped outright, and expired reports are discarded whenever
+// their level is rebuilt (on a merge, or once more than half of a level has expired).
+
+const size_t DYNAMIC_BUFFER_SIZE = 64;
+
+struct DynamicKDIndex {
+    struct Level {
+        vector<Point> pts;      // owned; the tree points into it
+        FlatKDTree tree;
+        long min_ts = 0, max_ts = 0;
+        size_t expired = 0;
+    };
+    vector<Point> buffer;
+    vector<unique_ptr<Level>> levels;   // levels[i] is null or holds <= BUFFER << i reports
+    long min_ts = numeric_limits<long>::min();   // reports older than this are expired
+
+    size_t capacity(size_t i) const { return DYNAMIC_BUFFER_SIZE << i; }
+
+    size_t size() const {
+        size_t n = 0;
+        for (auto &p : buffer) if (p.timestamp >= min_ts) ++n;
+        for (auto &lv : levels) if (lv) n += lv->pts.size() - lv->expired;
+        return n;
+    }
+
+    unique_ptr<Level> make_level(vector<Point> pts) {
+        auto lv = make_unique<Level>();
+        lv->pts = move(pts);
+        lv->min_ts = numeric_limits<long>::max();
+        lv->max_ts = numeric_limits<long>::min();
+        for (auto &p : lv->pts) { lv->min_ts = min(lv->min_ts, p.timestamp); lv->max_ts = max(lv->max_ts, p.timestamp); }
+        lv->tree.build(lv->pts);
+        return lv;
+    }
+
+    void insert(const Point &p) {
+        if (p.timestamp < min_ts) return; // already expired
+        buffer.push_back(p);
+        if (buffer.size() < DYNAMIC_BUFFER_SIZE) return;
+        vector<Point> carry;
+        carry.swap(buffer);
+        size_t i = 0;
+        for (; i < levels.size() && levels[i]; ++i) {
+            for (auto &q : levels[i]->pts) if (q.timestamp >= min_ts) carry.push_back(move(q));
+            levels[i].reset();
+        }
+        if (i == levels.size()) levels.emplace_back();
+        // carry <= buffer + sum of capacities below i == capacity(i)
+        levels[i] = make_level(move(carry));
+    }
+
+    void expire_before(long cutoff) {
+        if (cutoff <= min_ts) return;
+        min_ts = cutoff;
+        buffer.erase(remove_if(buffer.begin(), buffer.end(), [&](const Point &p) { return p.timestamp < min_ts; }),
+                     buffer.end());
+        for (auto &lv : levels) {
+            if (!lv || lv->min_ts >= min_ts) continue;
+            if (lv->max_ts < min_ts) { lv.reset(); continue; }
+            lv->expired = count_if(lv->pts.begin(), lv->pts.end(), [&](const Point &p) { return p.timestamp < min_ts; });
+            if (lv->expired * 2 > lv->pts.size()) {
+                vector<Point> keep;
+                for (auto &p : lv->pts) if (p.timestamp >= min_ts) keep.push_back(move(p));
+                lv = make_level(move(keep));
+            }
+        }
+    }
+
+    vector<Neighbor> knn_query(double qlat, double qlon, int K) const {
+        vector<pair<double,const Point*>> best;
+        if (K <= 0) return {};
+        best.reserve(K);
+        for (auto &p : buffer) {
+            if (p.timestamp < min_ts) continue;
+            double d = haversine_distance_m(qlat, qlon, p.lat, p.lon);
+            if ((int)best.size() == K && d >= best.back().first) continue;
+            if ((int)best.size() < K) best.emplace_back();
+            int j = (int)best.size() - 1;
+            while (j > 0 && best[j - 1].first > d) { best[j] = best[j - 1]; --j; }
+            best[j] = {d, &p};
+        }
+        // Largest (oldest) levels first: they usually hold the nearest reports
+        for (size_t i = levels.size(); i-- > 0;)
+            if (levels[i]) levels[i]->tree.knn_accumulate(qlat, qlon, K, min_ts, best);
+        vector<Neighbor> result;
+        result.reserve(best.size());
+        for (auto &b : best) result.push_back({b.first, b.second->label, b.second->id});
+        return result;
+    }
+};
+
+// Run fn(begin, end) over [0, n) split into one contiguous chunk per thread
+template <class F>
+void parallel_for(size_t n, int threads, F fn) {
+    if (threads <= 1 || n < 2) { fn((size_t)0, n); return; }
+    size_t t = min((size_t)threads, n);
+    size_t chunk = (n + t - 1) / t;
+    vector<thread> pool;
+    for (size_t b = 0; b < n; b += chunk) pool.emplace_back(fn, b, min(n, b + chunk));
+    for (auto &th : pool) th.join();
+}
+
+// --------------------------- Risk Raster ----------------------------------
+// The app asks about the same city over and over, so the inverse-distance weighted vote
+// (weighted_vote of the K nearest reports) can be precomputed on a lat/lon grid once.
+// File layout: RasterHeader, then height*width floats, row r = lat0 + r*(lat1-lat0)/(height-1),
+// column c = lon0 + c*(lon1-lon0)/(width-1). Serving maps the file read-only and answers a
+// query by bilinear interpolation of the four surrounding grid values; nothing is parsed
+// or copied at load time. Points outside the grid fall back to the exact KNN.
+
+struct RasterHeader {
+    char magic[8];          // "RISKRST1"
+    uint32_t width, height; // grid vertices along lon / lat
+    uint32_t k;             // neighbours used for the scores
+    uint32_t reserved;
+    double lat0, lat1, lon0, lon1;
+};
+static const char RASTER_MAGIC[8] = {'R','I','S','K','R','S','T','1'};
+
+bool write_risk_raster(const string &filename, const RasterHeader &h, const vector<float> &scores, string &err) {
+    ofstream fout(filename, ios::binary);
+    if (!fout.is_open()) { err = "Cannot open file for writing: " + filename; return false; }
+    fout.write(reinterpret_cast<const char*>(&h), sizeof(h));
+    fout.write(reinterpret_cast<const char*>(scores.data()), scores.size() * sizeof(float));
+    if (!fout) { err = "Write failed: " + filename; return false; }
+    return true;
+}
+
+struct RiskRaster {
+    const RasterHeader *header = nullptr;
+    const float *scores = nullptr;
+    void *map = nullptr;
+    size_t map_size = 0;
+
+    RiskRaster() = default;
+    RiskRaster(const RiskRaster&) = delete;
+    RiskRaster& operator=(const RiskRaster&) = delete;
+    ~RiskRaster() { if (map) munmap(map, map_size); }
+
+    bool open(const string &filename, string &err) {
+        int fd = ::open(filename.c_str(), O_RDONLY);
+        if (fd < 0) { err = "Cannot open raster: " + filename; return false; }
+        struct stat st;
+        if (fstat(fd, &st) != 0 || (size_t)st.st_size < sizeof(RasterHeader)) {
+            ::close(fd);
+            err = "Raster too small: " + filename;
+            return false;
+        }
+        map_size = (size_t)st.st_size;
+        map = mmap(nullptr, map_size, PROT_READ, MAP_SHARED, fd, 0);
+        ::close(fd);
+        if (map == MAP_FAILED) { map = nullptr; err = "mmap failed: " + filename; return false; }
+        header = static_cast<const RasterHeader*>(map);
+        if (memcmp(header->magic, RASTER_MAGIC, 8) != 0 || header->width < 2 || header->height < 2 ||
+            map_size < sizeof(RasterHeader) + (size_t)header->width * header->height * sizeof(float)) {
+            err = "Not a valid risk raster: " + filename;
+            return false;
+        }
+        scores = reinterpret_cast<const float*>(static_cast<const char*>(map) + sizeof(RasterHeader));
+        return true;
+    }
+
+    bool contains(double lat, double lon) const {
+        return lat >= header->lat0 && lat <= header->lat1 && lon >= header->lon0 && lon <= header->lon1;
+    }
+
+    // Bilinear interpolation; caller checks contains()
+    float lookup(double lat, double lon) const {
+        const RasterHeader &h = *header;
+        double fy = (lat - h.lat0) / (h.lat1 - h.lat0) * (h.height - 1);
+        double fx = (lon - h.lon0) / (h.lon1 - h.lon0) * (h.width - 1);
+        int r = min((int)fy, (int)h.height - 2), c = min((int)fx, (int)h.width - 2);
+        float ty = (float)(fy - r), tx = (float)(fx - c);
+        const float *row0 = scores + (size_t)r * h.width + c, *row1 = row0 + h.width;
+        float top = row0[0] + (row0[1] - row0[0]) * tx;
+        float bottom = row1[0] + (row1[1] - row1[0]) * tx;
+        return top + (bottom - top) * ty;
+    }
+};
+
 // --------------------------- CSV Reader -----------------------------------
 
 bool load_crime_csv(const string &filename, vector<Point> &out, string &err) {
@@ -296,12 +711,25 @@ bool load_crime_csv(const string &filename, vector<Point> &out, string &err) {
 // --------------------------- Main and CLI ---------------------------------
 
 void print_usage() {
-    cerr << "Usage: knn_location_risk data.csv --mode [bruteforce|kdtree] --k K --query lat lon\n";
+    cerr << "Usage: knn_location_risk data.csv --mode [bruteforce|kdtree|flatkd|simd|dynamic|auto] --k K --query lat lon\n";
     cerr << "Options:\n";
-    cerr << "  --mode    bruteforce (default) or kdtree\n";
+    cerr << "  --mode    bruteforce (default), kdtree, flatkd (contiguous bucketed KD-tree),\n";
+    cerr << "            simd (vectorized linear scan), dynamic (accepts new reports while running)\n";
+    cerr << "            or auto (simd for small data, else flatkd)\n";
     cerr << "  --k       number of neighbors (default 5)\n";
     cerr << "  --weight  voting weight: plain or inverse (default inverse)\n";
-    cerr << "  --batch   batch query file with lines 'lat,lon'\n";
+    cerr << "  --batch   batch query file with lines 'lat,lon' (answered in parallel)\n";
+    cerr << "  --threads worker threads for --batch (default: hardware threads)\n";
+    cerr << "  --compare with --batch: time every mode on the batch and check they agree;\n";
+    cerr << "            with --raster: report raster error against the exact KNN score\n";
+    cerr << "  --build-raster FILE  precompute the weighted-vote risk score on a grid and exit\n";
+    cerr << "  --raster-size W H    grid vertices along longitude / latitude (default 512 512)\n";
+    cerr << "  --raster-bounds LAT0 LAT1 LON0 LON1  grid extent (default: bounding box of the data)\n";
+    cerr << "  --raster FILE        answer queries from a prebuilt raster (memory-mapped)\n";
+    cerr << "  --ttl SECONDS        ignore reports older than the newest report minus SECONDS\n";
+    cerr << "Interactive input with --mode dynamic also accepts:\n";
+    cerr << "  ADD id,lat,lon,label,severity,timestamp   index a new report\n";
+    cerr << "  EXPIRE timestamp                          drop reports older than timestamp\n";
 }
 
 int main(int argc, char** argv) {
@@ -312,6 +740,13 @@ int main(int argc, char** argv) {
     string weight = "inverse";
     bool batch_mode = false;
     string batch_file;
+    int threads = max(1u, thread::hardware_concurrency());
+    bool compare = false;
+    string build_raster_file, raster_file;
+    int raster_w = 512, raster_h = 512;
+    bool raster_bounds_given = false;
+    double r_lat0 = 0, r_lat1 = 0, r_lon0 = 0, r_lon1 = 0;
+    long ttl = -1;
 
     // Simple CLI parsing
     for (int i=2;i<argc;++i) {
@@ -320,6 +755,20 @@ int main(int argc, char** argv) {
         else if (s == "--k" && i+1<argc) { K = stoi(argv[++i]); }
         else if (s == "--weight" && i+1<argc) { weight = argv[++i]; }
         else if (s == "--batch" && i+1<argc) { batch_mode = true; batch_file = argv[++i]; }
+        else if (s == "--threads" && i+1<argc) { threads = max(1, stoi(argv[++i])); }
+        else if (s == "--compare") { compare = true; }
+        else if (s == "--build-raster" && i+1<argc) { build_raster_file = argv[++i]; }
+        else if (s == "--raster" && i+1<argc) { raster_file = argv[++i]; }
+        else if (s == "--raster-size" && i+2<argc) {
+            raster_w = max(2, stoi(argv[++i]));
+            raster_h = max(2, stoi(argv[++i]));
+        }
+        else if (s == "--raster-bounds" && i+4<argc) {
+            raster_bounds_given = true;
+            r_lat0 = stod(argv[++i]); r_lat1 = stod(argv[++i]);
+            r_lon0 = stod(argv[++i]); r_lon1 = stod(argv[++i]);
+        }
+        else if (s == "--ttl" && i+1<argc) { ttl = max(0L, stol(argv[++i])); }
         else if (s == "--help") { print_usage(); return 0; }
     }
 
@@ -332,21 +781,59 @@ int main(int argc, char** argv) {
     }
     cout << "Loaded " << data.size() << " points.\n";
 
+    // Reports older than the TTL window are dropped up front so every mode sees the same data
+    long newest_ts = numeric_limits<long>::min();
+    for (const auto &p : data) newest_ts = max(newest_ts, p.timestamp);
+    if (ttl >= 0 && !data.empty()) {
+        size_t before = data.size();
+        data.erase(remove_if(data.begin(), data.end(), [&](const Point &p) { return p.timestamp < newest_ts - ttl; }),
+                   data.end());
+        cout << "TTL " << ttl << "s: kept " << data.size() << " of " << before << " reports.\n";
+    }
+
+    if (mode == "auto") {
+        mode = data.size() <= AUTO_BRUTEFORCE_MAX_POINTS ? "simd" : "flatkd";
+        cout << "Auto mode selected '" << mode << "' for " << data.size() << " points.\n";
+    }
+
     // Build KD-tree if requested
     KDTree tree;
-    if (mode == "kdtree") {
+    FlatKDTree flat_tree;
+    if (mode == "kdtree" || compare) {
         cout << "Building KD-tree ...\n";
         tree.build(data);
         cout << "KD-tree built.\n";
     }
+    if (mode == "flatkd" || compare) {
+        cout << "Building flat KD-tree ...\n";
+        flat_tree.build(data);
+        cout << "Flat KD-tree built (depth " << flat_tree.depth << ", leaf size <= " << FLAT_KD_LEAF_SIZE << ").\n";
+    }
+    SimdBruteForce simd_scan;
+    if (mode == "simd" || compare) simd_scan.build(data);
+    DynamicKDIndex dynamic_index;
+    if (mode == "dynamic" || compare) {
+        cout << "Building dynamic KD index ...\n";
+        // Append in report order, as a live feed would
+        vector<int> order(data.size());
+        iota(order.begin(), order.end(), 0);
+        stable_sort(order.begin(), order.end(), [&](int a, int b) { return data[a].timestamp < data[b].timestamp; });
+        for (int i : order) dynamic_index.insert(data[i]);
+        size_t nlevels = 0;
+        for (auto &lv : dynamic_index.levels) if (lv) ++nlevels;
+        cout << "Dynamic KD index built (" << nlevels << " trees + " << dynamic_index.buffer.size() << " buffered).\n";
+    }
+
+    auto knn_with = [&](const string &m, double qlat, double qlon) -> vector<Neighbor> {
+        if (m == "kdtree") return tree.knn_query(qlat, qlon, K);
+        if (m == "flatkd") return flat_tree.knn_query(qlat, qlon, K);
+        if (m == "simd") return simd_scan.knn_query(qlat, qlon, K);
+        if (m == "dynamic") return dynamic_index.knn_query(qlat, qlon, K);
+        return knn_bruteforce(data, qlat, qlon, K);
+    };
 
     auto classify_point = [&](double qlat, double qlon) -> pair<int, vector<Neighbor>> {
-        vector<Neighbor> neighbors;
-        if (mode == "kdtree") {
-            neighbors = tree.knn_query(qlat, qlon, K);
-        } else {
-            neighbors = knn_bruteforce(data, qlat, qlon, K);
-        }
+        vector<Neighbor> neighbors = knn_with(mode, qlat, qlon);
 
         // Voting
         int label = 0;
@@ -359,18 +846,128 @@ int main(int argc, char** argv) {
         return {label, neighbors};
     };
 
+    if (!build_raster_file.empty()) {
+        if (data.empty()) { cerr << "Error: no data to build a raster from\n"; return 1; }
+        if (!raster_bounds_given) {
+            r_lat0 = r_lat1 = data[0].lat;
+            r_lon0 = r_lon1 = data[0].lon;
+            for (const auto &p : data) {
+                r_lat0 = min(r_lat0, p.lat); r_lat1 = max(r_lat1, p.lat);
+                r_lon0 = min(r_lon0, p.lon); r_lon1 = max(r_lon1, p.lon);
+            }
+        }
+        if (!(r_lat1 > r_lat0) || !(r_lon1 > r_lon0)) { cerr << "Error: empty raster bounds\n"; return 1; }
+        RasterHeader h{};
+        memcpy(h.magic, RASTER_MAGIC, 8);
+        h.width = raster_w; h.height = raster_h; h.k = K;
+        h.lat0 = r_lat0; h.lat1 = r_lat1; h.lon0 = r_lon0; h.lon1 = r_lon1;
+        cout << "Building " << raster_w << "x" << raster_h << " risk raster with " << mode << " KNN (K=" << K
+             << ") over lat [" << r_lat0 << ", " << r_lat1 << "], lon [" << r_lon0 << ", " << r_lon1 << "] ...\n";
+        vector<float> scores((size_t)raster_w * raster_h);
+        auto t0 = chrono::steady_clock::now();
+        parallel_for((size_t)raster_h, threads, [&](size_t rb, size_t re) {
+            for (size_t r = rb; r < re; ++r) {
+                double lat = r_lat0 + (r_lat1 - r_lat0) * r / (raster_h - 1);
+                for (int c = 0; c < raster_w; ++c) {
+                    double lon = r_lon0 + (r_lon1 - r_lon0) * c / (raster_w - 1);
+                    scores[r * raster_w + c] = (float)weighted_vote(knn_with(mode, lat, lon));
+                }
+            }
+        });
+        double ms = chrono::duration<double, milli>(chrono::steady_clock::now() - t0).count();
+        if (!write_risk_raster(build_raster_file, h, scores, err)) { cerr << "Error: " << err << "\n"; return 1; }
+        cout << "Raster built in " << ms << " ms and written to " << build_raster_file << "\n";
+        return 0;
+    }
+
+    RiskRaster raster;
+    bool use_raster = !raster_file.empty();
+    if (use_raster) {
+        if (!raster.open(raster_file, err)) { cerr << "Error: " << err << "\n"; return 1; }
+        cout << "Mapped risk raster " << raster.header->width << "x" << raster.header->height
+             << " (K=" << raster.header->k << ") from " << raster_file << "\n";
+        if ((int)raster.header->k != K)
+            cerr << "Warning: raster was built with K=" << raster.header->k << ", exact fallback uses K=" << K << "\n";
+    }
+    // Raster answer where the grid covers the query, exact KNN elsewhere
+    auto classify_label = [&](double qlat, double qlon) -> int {
+        if (use_raster && raster.contains(qlat, qlon)) return raster.lookup(qlat, qlon) >= 0.5f ? 1 : 0;
+        return classify_point(qlat, qlon).first;
+    };
+
     if (batch_mode) {
         ifstream fin(batch_file);
         if (!fin.is_open()) { cerr << "Cannot open batch file\n"; return 1; }
+        vector<pair<double,double>> queries;
         string line;
         while (getline(fin, line)) {
             vector<string> f; parse_csv_line(line, f);
             if (f.size() < 2) continue;
-            double lat = stod(f[0]); double lon = stod(f[1]);
-            auto res = classify_point(lat, lon);
-            cout << lat << "," << lon << " => " << (res.first==1 ? "Risky" : "Safe") << "\n";
+            try { queries.push_back({stod(f[0]), stod(f[1])}); }
+            catch (...) { continue; } // header or malformed row
         }
         fin.close();
+
+        // Queries are independent: answer them in parallel, print in input order
+        vector<int> labels(queries.size());
+        auto t0 = chrono::steady_clock::now();
+        parallel_for(queries.size(), threads, [&](size_t b, size_t e) {
+            for (size_t i = b; i < e; ++i) labels[i] = classify_label(queries[i].first, queries[i].second);
+        });
+        double ms = chrono::duration<double, milli>(chrono::steady_clock::now() - t0).count();
+        for (size_t i = 0; i < queries.size(); ++i)
+            cout << queries[i].first << "," << queries[i].second << " => " << (labels[i]==1 ? "Risky" : "Safe") << "\n";
+        cerr << "Classified " << queries.size() << " queries with " << (use_raster ? "raster" : mode) << " in " << ms << " ms ("
+             << (ms > 0 ? queries.size() / ms * 1000.0 : 0.0) << " queries/s, " << threads << " threads)\n";
+
+        if (compare && use_raster) {
+            // Raster error report against the exact weighted vote
+            size_t inside = 0, label_diff = 0;
+            double sum_err = 0, max_err = 0;
+            float sink = 0;
+            auto l0 = chrono::steady_clock::now();
+            for (auto &q : queries) if (raster.contains(q.first, q.second)) sink += raster.lookup(q.first, q.second);
+            double lookup_ns = chrono::duration<double, nano>(chrono::steady_clock::now() - l0).count();
+            for (auto &q : queries) {
+                if (!raster.contains(q.first, q.second)) continue;
+                ++inside;
+                double exact = weighted_vote(knn_with(mode, q.first, q.second));
+                double approx = raster.lookup(q.first, q.second);
+                double e = fabs(exact - approx);
+                sum_err += e;
+                max_err = max(max_err, e);
+                if ((exact >= 0.5) != (approx >= 0.5)) ++label_diff;
+            }
+            cerr << "Raster vs exact " << mode << " KNN on " << inside << " queries inside the grid"
+                 << " (" << queries.size() - inside << " outside used exact KNN):\n";
+            cerr << "  mean |score error| = " << (inside ? sum_err / inside : 0.0) << ", max = " << max_err
+                 << ", labels differ on " << label_diff << " queries\n";
+            cerr << "  lookup cost " << (inside ? lookup_ns / inside : 0.0) << " ns/query"
+                 << (sink < 0 ? " " : "") << "\n";
+        } else if (compare) {
+            // Throughput of every mode on the same batch, and agreement with brute force
+            vector<vector<Neighbor>> reference(queries.size());
+            for (string m : {"bruteforce", "kdtree", "flatkd", "simd", "dynamic"}) {
+                vector<vector<Neighbor>> found(queries.size());
+                auto c0 = chrono::steady_clock::now();
+                parallel_for(queries.size(), threads, [&](size_t b, size_t e) {
+                    for (size_t i = b; i < e; ++i) found[i] = knn_with(m, queries[i].first, queries[i].second);
+                });
+                double cms = chrono::duration<double, milli>(chrono::steady_clock::now() - c0).count();
+                if (m == "bruteforce") reference = found;
+                size_t mismatches = 0;
+                for (size_t i = 0; i < queries.size(); ++i) {
+                    bool same = found[i].size() == reference[i].size();
+                    for (size_t j = 0; same && j < found[i].size(); ++j)
+                        same = fabs(found[i][j].dist - reference[i][j].dist) < 1e-6;
+                    if (!same) ++mismatches;
+                }
+                cerr << "  " << setw(10) << m << ": " << fixed << setprecision(2) << cms << " ms, "
+                     << (cms > 0 ? queries.size() / cms * 1000.0 : 0.0) << " queries/s, "
+                     << mismatches << " queries differ from bruteforce\n";
+                cerr.unsetf(ios::fixed);
+            }
+        }
         return 0;
     }
 
@@ -383,10 +980,36 @@ int main(int argc, char** argv) {
         trim(line);
         if (line.empty()) continue;
         if (line == "exit" || line == "quit") break;
+        if (line.rfind("ADD ", 0) == 0 || line.rfind("EXPIRE ", 0) == 0) {
+            if (mode != "dynamic") { cerr << "ADD / EXPIRE need --mode dynamic\n"; continue; }
+            if (line[0] == 'E') {
+                try { dynamic_index.expire_before(stol(line.substr(7))); }
+                catch (...) { cerr << "Please enter: EXPIRE timestamp\n"; continue; }
+            } else {
+                vector<string> f; parse_csv_line(line.substr(4), f);
+                Point p;
+                try {
+                    if (f.size() < 6) throw invalid_argument("fields");
+                    p = {f[0], stod(f[1]), stod(f[2]), stoi(f[3]), stoi(f[4]), stol(f[5])};
+                } catch (...) { cerr << "Please enter: ADD id,lat,lon,label,severity,timestamp\n"; continue; }
+                dynamic_index.insert(p);
+                if (ttl >= 0 && p.timestamp > newest_ts) {
+                    newest_ts = p.timestamp;
+                    dynamic_index.expire_before(newest_ts - ttl);
+                }
+            }
+            cout << "Indexed reports: " << dynamic_index.size() << "\n";
+            continue;
+        }
         vector<string> parts; parse_csv_line(line, parts);
         if (parts.size() < 2) { cerr << "Please enter: lat,lon\n"; continue; }
         double qlat = stod(parts[0]);
         double qlon = stod(parts[1]);
+        if (use_raster && raster.contains(qlat, qlon)) {
+            float score = raster.lookup(qlat, qlon);
+            cout << (score >= 0.5f ? "Risky" : "Safe") << " (raster score " << score << ")\n";
+            continue;
+        }
         auto res = classify_point(qlat, qlon);
         int label = res.first;
         cout << (label==1 ? "Risky" : "Safe") << "\n";
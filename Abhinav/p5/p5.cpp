@@ -8,13 +8,19 @@
 //  - Query top-k suggestions by prefix (case-insensitive)
 //  - Maintain frequency counts for ranking suggestions
 //  - Support deletion of entries
-//  - Optional fuzzy fallback using simple Levenshtein scan for small datasets
+//  - Optional fuzzy fallback: prefixes within 1-2 edits, found by walking the trie
 //  - Interactive REPL and batch query mode
+//  - Optional lock-free snapshot reads (--snapshot) and a read-scaling benchmark (--bench)
+//  - Offline index build (--build-index) and instant start from the memory-mapped file (--index)
 //
-// Note: This is an educational implementation; production systems use optimised
-// tries (radix/compressed), disk-backed stores, and persistence.
+// The trie is path-compressed (radix) and keeps all nodes, edge labels and caches in
+// contiguous arenas, so a few million addresses fit in a few hundred MB.
 
 #include <bits/stdc++.h>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
 using namespace std;
 
 // --------------------------- Utilities ------------------------------------
@@ -33,7 +39,7 @@ static inline string to_lower_normalize(const string &s) {
     for (char ch : s) {
         // normalize: convert to lowercase, keep alphanum and basic punctuation/spaces
         char c = ch;
-        if (unsigned char(c) >= 128) {
+        if ((unsigned char)c >= 128) {
             // skip non-ascii accents for simplicity; production should use unicode normalization
             continue;
         }
@@ -66,34 +72,26 @@ struct Suggestion {
     uint64_t last_ts; // last-used timestamp for recency tie-break
 };
 
+// Radix (path-compressed) trie node. A node owns the edge label leading into it, so chains
+// of single-child nodes collapse into one. Nodes are plain records in the RadixTrie arenas
+// below and refer to each other by 32-bit ids.
 struct TrieNode {
-    // For simplicity using unordered_map for children to support large char set.
-    unordered_map<char, TrieNode*> children;
-    bool is_end = false;
-    // if node corresponds to an entry end, store an index to suggestion store
-    vector<int> suggestion_indices; // indices into global suggestion pool for entries ending here (usually 1)
-    // We also keep top suggestions cache for this subtree to accelerate queries
-    // (store indices to global suggestions and maintain it upon inserts/deletes)
-    vector<int> top_cache; // stores indices into global suggestions, sorted by score
-    mutable std::shared_mutex node_mutex; // to allow concurrent reads and safe updates
+    uint32_t label_off = 0;     // edge label: label_pool[label_off, label_off + label_len)
+    uint32_t label_len = 0;
+    uint32_t child_off = 0;     // sorted slab in child_chars/child_nodes, or 256-way table in dense_pool
+    uint16_t child_count = 0;
+    uint8_t child_cap_log = 0;  // slab capacity is 1 << child_cap_log
+    uint8_t dense = 0;          // children live in a 256-way table
+    int32_t end_head = -1;      // first end_pool entry for suggestions ending here, -1 if none
+    uint8_t cache_count = 0;    // used slots of this node's top-suggestion cache
 };
 
-// --------------------------- Global store ---------------------------------
+// --------------------------- Parameters -----------------------------------
 
-// Global vector of suggestions (strings and metadata)
-vector<Suggestion> suggestion_store;
-
-// Map from key string to index in suggestion_store
-unordered_map<string, int> key_to_index;
-
-// Root of trie
-TrieNode *root = nullptr;
-
-// Parameters
-size_t MAX_CACHE_PER_NODE = 10; // how many top suggestions we cache per node
-
-// Lock for suggestion store writes
-std::mutex store_mutex;
+size_t MAX_CACHE_PER_NODE = 10; // how many top suggestions we cache per node (fixed once the trie has nodes, <= 255)
+const int MAX_SNAPSHOT_READERS = 256; // reader threads that can register with a SnapshotIndex
+const size_t BENCH_WRITE_BATCH = 64;  // inserts per published batch in --bench
+const int STRESS_CHECK_EVERY = 1000;  // --stress operations between full-scan checks
 
 // --------------------------- Ranking helpers -------------------------------
 
@@ -105,177 +103,474 @@ uint64_t compute_score(const Suggestion &s) {
     return (s.freq << 32) | (s.last_ts & 0xffffffff);
 }
 
-// Compare two indices by suggestion score (higher first), fallback lexicographic
-bool suggestion_cmp_idx(int a, int b) {
-    const Suggestion &sa = suggestion_store[a];
-    const Suggestion &sb = suggestion_store[b];
-    uint64_t ra = compute_score(sa);
-    uint64_t rb = compute_score(sb);
-    if (ra != rb) return ra > rb;
-    if (sa.key != sb.key) return sa.key < sb.key;
-    return a < b;
+// Compare two indices of a store by suggestion score (higher first), fallback lexicographic
+struct SuggestionOrder {
+    const vector<Suggestion> &store;
+    bool operator()(int a, int b) const {
+        const Suggestion &sa = store[a];
+        const Suggestion &sb = store[b];
+        uint64_t ra = compute_score(sa);
+        uint64_t rb = compute_score(sb);
+        if (ra != rb) return ra > rb;
+        if (sa.key != sb.key) return sa.key < sb.key;
+        return a < b;
+    }
+};
+
+// Merge idx into a node cache holding up to MAX_CACHE_PER_NODE best suggestions.
+// Only valid when idx's score did not decrease (new entry or frequency bump): idx then can
+// only enter the cache or move up, so it is slid into place without a full sort.
+// Decreases go through RadixTrie::refresh_path instead.
+void merge_into_cache(int *cache, uint8_t &count, int idx, const SuggestionOrder &cmp) {
+    int pos = (int)(find(cache, cache + count, idx) - cache);
+    if (pos == count) {
+        if (count < MAX_CACHE_PER_NODE) ++count;
+        else if (!cmp(idx, cache[count - 1])) return;
+        pos = count - 1;
+    }
+    while (pos > 0 && cmp(idx, cache[pos - 1])) { cache[pos] = cache[pos - 1]; --pos; }
+    cache[pos] = idx;
 }
 
-// Merge top caches: node cache is kept up to MAX_CACHE_PER_NODE best suggestions
-void merge_into_cache(vector<int> &cache, int idx) {
-    // if idx already present, update it
-    for (int &x : cache) {
-        if (x == idx) {
-            // resort
-            sort(cache.begin(), cache.end(), suggestion_cmp_idx);
-            if (cache.size() > MAX_CACHE_PER_NODE) cache.resize(MAX_CACHE_PER_NODE);
-            return;
+// --------------------------- Radix trie ------------------------------------
+
+const uint32_t NO_NODE = UINT32_MAX;
+const uint32_t DENSE_CHILDREN = 16; // beyond this many children a node switches to a 256-way table
+
+// All trie storage lives in a handful of arenas instead of one heap object per character:
+//  nodes        fixed-size node records (node 0 is the root)
+//  label_pool   edge label bytes
+//  child_*      sorted child lists (first label byte, node id) in power-of-two slabs
+//  dense_pool   256-way child tables of dense nodes (0 = no child)
+//  cache_pool   MAX_CACHE_PER_NODE top-suggestion slots per node
+//  end_pool     suggestion indices ending at a node, as short linked lists
+struct RadixTrie {
+    struct EndEntry { int idx; int32_t next; };
+
+    vector<TrieNode> nodes;
+    string label_pool;
+    vector<unsigned char> child_chars;
+    vector<uint32_t> child_nodes;
+    vector<uint32_t> free_slabs[5];     // released slabs by capacity log2, up to DENSE_CHILDREN
+    vector<uint32_t> dense_pool;
+    vector<int> cache_pool;
+    vector<EndEntry> end_pool;
+
+    void clear() {
+        *this = RadixTrie();
+        new_node(0, 0);
+    }
+
+    uint32_t new_node(uint32_t label_off, uint32_t label_len) {
+        TrieNode n;
+        n.label_off = label_off;
+        n.label_len = label_len;
+        nodes.push_back(n);
+        cache_pool.resize(cache_pool.size() + MAX_CACHE_PER_NODE, -1);
+        return (uint32_t)nodes.size() - 1;
+    }
+
+    int* cache(uint32_t n) { return &cache_pool[(size_t)n * MAX_CACHE_PER_NODE]; }
+    const int* cache(uint32_t n) const { return &cache_pool[(size_t)n * MAX_CACHE_PER_NODE]; }
+
+    uint32_t find_child(uint32_t n, unsigned char c) const {
+        const TrieNode &nd = nodes[n];
+        if (nd.dense) { uint32_t x = dense_pool[nd.child_off + c]; return x ? x : NO_NODE; }
+        for (uint32_t i = nd.child_off, e = i + nd.child_count; i < e; ++i) {
+            if (child_chars[i] == c) return child_nodes[i];
+            if (child_chars[i] > c) break;
         }
+        return NO_NODE;
     }
-    cache.push_back(idx);
-    sort(cache.begin(), cache.end(), suggestion_cmp_idx);
-    if (cache.size() > MAX_CACHE_PER_NODE) cache.resize(MAX_CACHE_PER_NODE);
-}
 
-// --------------------------- Trie operations -------------------------------
+    // Visit children in byte order
+    template <class F> void for_each_child(uint32_t n, F f) const {
+        const TrieNode &nd = nodes[n];
+        if (nd.dense) {
+            for (int c = 0; c < 256; ++c) if (dense_pool[nd.child_off + c]) f(dense_pool[nd.child_off + c]);
+        } else {
+            for (uint32_t i = nd.child_off, e = i + nd.child_count; i < e; ++i) f(child_nodes[i]);
+        }
+    }
 
-TrieNode* make_node() {
-    TrieNode* node = new TrieNode();
-    return node;
-}
+    uint32_t alloc_slab(int cap_log) {
+        auto &fl = free_slabs[cap_log];
+        if (!fl.empty()) { uint32_t off = fl.back(); fl.pop_back(); return off; }
+        uint32_t off = (uint32_t)child_nodes.size();
+        child_chars.resize(off + (1u << cap_log));
+        child_nodes.resize(off + (1u << cap_log));
+        return off;
+    }
+
+    void add_child(uint32_t n, unsigned char c, uint32_t child) {
+        TrieNode &nd = nodes[n];
+        if (!nd.dense && nd.child_count == DENSE_CHILDREN) {
+            uint32_t off = (uint32_t)dense_pool.size();
+            dense_pool.resize(off + 256, 0);
+            for (uint32_t i = 0; i < nd.child_count; ++i)
+                dense_pool[off + child_chars[nd.child_off + i]] = child_nodes[nd.child_off + i];
+            free_slabs[nd.child_cap_log].push_back(nd.child_off);
+            nd.dense = 1;
+            nd.child_off = off;
+        }
+        if (nd.dense) { dense_pool[nd.child_off + c] = child; ++nd.child_count; return; }
+        if (nd.child_count == 0) {
+            nd.child_cap_log = 0;
+            nd.child_off = alloc_slab(0);
+        } else if (nd.child_count == (1u << nd.child_cap_log)) {
+            uint32_t off = alloc_slab(nd.child_cap_log + 1);
+            copy_n(child_chars.begin() + nd.child_off, nd.child_count, child_chars.begin() + off);
+            copy_n(child_nodes.begin() + nd.child_off, nd.child_count, child_nodes.begin() + off);
+            free_slabs[nd.child_cap_log].push_back(nd.child_off);
+            nd.child_off = off;
+            ++nd.child_cap_log;
+        }
+        uint32_t i = nd.child_off + nd.child_count;
+        for (; i > nd.child_off && child_chars[i - 1] > c; --i) {
+            child_chars[i] = child_chars[i - 1];
+            child_nodes[i] = child_nodes[i - 1];
+        }
+        child_chars[i] = c;
+        child_nodes[i] = child;
+        ++nd.child_count;
+    }
+
+    // Repoint the existing child edge starting with c
+    void replace_child(uint32_t n, unsigned char c, uint32_t child) {
+        const TrieNode &nd = nodes[n];
+        if (nd.dense) { dense_pool[nd.child_off + c] = child; return; }
+        for (uint32_t i = nd.child_off, e = i + nd.child_count; i < e; ++i)
+            if (child_chars[i] == c) { child_nodes[i] = child; return; }
+    }
+
+    void add_end(uint32_t n, int idx) {
+        for (int32_t e = nodes[n].end_head; e != -1; e = end_pool[e].next)
+            if (end_pool[e].idx == idx) return;
+        end_pool.push_back({idx, nodes[n].end_head});
+        nodes[n].end_head = (int32_t)end_pool.size() - 1;
+    }
+
+    void remove_end(uint32_t n, int idx) {
+        for (int32_t *link = &nodes[n].end_head; *link != -1; link = &end_pool[*link].next)
+            if (end_pool[*link].idx == idx) { *link = end_pool[*link].next; return; }
+    }
+
+    // Nodes from the root down to where the stored key ends (empty if key is not in the trie)
+    vector<uint32_t> path_to(const string &key) const {
+        vector<uint32_t> path{0};
+        size_t i = 0;
+        while (i < key.size()) {
+            uint32_t child = find_child(path.back(), key[i]);
+            if (child == NO_NODE) return {};
+            const TrieNode &c = nodes[child];
+            if (i + c.label_len > key.size() || label_pool.compare(c.label_off, c.label_len, key, i, c.label_len) != 0)
+                return {};
+            path.push_back(child);
+            i += c.label_len;
+        }
+        return path;
+    }
+
+    // Recompute node n's cache from its own live entries and its children's caches, which
+    // hold the top suggestions of each child subtree, so their union contains the top of n's
+    void rebuild_cache(uint32_t n, const vector<Suggestion> &store) {
+        vector<int> cand;
+        for (int32_t e = nodes[n].end_head; e != -1; e = end_pool[e].next)
+            if (!store[end_pool[e].idx].key.empty()) cand.push_back(end_pool[e].idx);
+        for_each_child(n, [&](uint32_t c) {
+            const int *cc = cache(c);
+            for (int i = 0; i < nodes[c].cache_count; ++i)
+                if (!store[cc[i]].key.empty()) cand.push_back(cc[i]);
+        });
+        size_t m = min(cand.size(), MAX_CACHE_PER_NODE);
+        partial_sort(cand.begin(), cand.begin() + m, cand.end(), SuggestionOrder{store});
+        copy_n(cand.begin(), m, cache(n));
+        nodes[n].cache_count = (uint8_t)m;
+    }
+
+    // store[idx]'s score dropped (or it was deleted): fix caches bottom-up along its path.
+    // A node whose cache does not hold idx is unaffected, and then neither are its
+    // ancestors, since a parent only caches what some child caches or what ends at it.
+    void refresh_path(const vector<uint32_t> &path, int idx, const vector<Suggestion> &store) {
+        for (size_t p = path.size(); p-- > 0;) {
+            uint32_t n = path[p];
+            const int *c = cache(n);
+            if (find(c, c + nodes[n].cache_count, idx) == c + nodes[n].cache_count) break;
+            rebuild_cache(n, store);
+        }
+    }
+
+    // Insert a normalized key ending at store[idx], updating caches along the path
+    void insert(const string &key, int idx, const vector<Suggestion> &store) {
+        SuggestionOrder cmp{store};
+        uint32_t cur = 0;
+        size_t i = 0;
+        while (true) {
+            merge_into_cache(cache(cur), nodes[cur].cache_count, idx, cmp);
+            if (i == key.size()) break;
+            uint32_t child = find_child(cur, key[i]);
+            if (child == NO_NODE) {
+                uint32_t off = (uint32_t)label_pool.size();
+                label_pool.append(key, i, string::npos);
+                uint32_t leaf = new_node(off, (uint32_t)(key.size() - i));
+                add_child(cur, key[i], leaf);
+                cur = leaf;
+                i = key.size();
+                continue;
+            }
+            uint32_t label_off = nodes[child].label_off, label_len = nodes[child].label_len;
+            uint32_t m = 1;
+            while (m < label_len && i + m < key.size() && label_pool[label_off + m] == key[i + m]) ++m;
+            if (m < label_len) {
+                // Split the edge: mid takes the matched part and, covering the same subtree, child's cache
+                uint32_t mid = new_node(label_off, m);
+                copy_n(cache(child), nodes[child].cache_count, cache(mid));
+                nodes[mid].cache_count = nodes[child].cache_count;
+                nodes[child].label_off += m;
+                nodes[child].label_len -= m;
+                add_child(mid, label_pool[label_off + m], child);
+                replace_child(cur, key[i], mid);
+                child = mid;
+            }
+            cur = child;
+            i += m;
+        }
+        add_end(cur, idx);
+    }
+
+    // Node whose subtree holds exactly the keys starting with norm (may end mid-edge)
+    uint32_t find_prefix(const string &norm) const {
+        uint32_t cur = 0;
+        size_t i = 0;
+        while (i < norm.size()) {
+            uint32_t child = find_child(cur, norm[i]);
+            if (child == NO_NODE) return NO_NODE;
+            const TrieNode &c = nodes[child];
+            size_t m = min<size_t>(c.label_len, norm.size() - i);
+            if (label_pool.compare(c.label_off, m, norm, i, m) != 0) return NO_NODE;
+            cur = child;
+            i += m;
+        }
+        return cur;
+    }
+
+    size_t memory_bytes() const {
+        size_t b = nodes.capacity() * sizeof(TrieNode) + label_pool.capacity() +
+                   child_chars.capacity() + child_nodes.capacity() * sizeof(uint32_t) +
+                   dense_pool.capacity() * sizeof(uint32_t) + cache_pool.capacity() * sizeof(int) +
+                   end_pool.capacity() * sizeof(EndEntry);
+        for (auto &fl : free_slabs) b += fl.capacity() * sizeof(uint32_t);
+        return b;
+    }
+};
+
+// --------------------------- Suggestion index ------------------------------
+
+// The suggestion store, its key lookup and the trie over it. The index_* operations do
+// no locking; the locked and snapshot wrappers below provide it.
+struct SuggestionIndex {
+    vector<Suggestion> store;                  // suggestion strings and metadata
+    unordered_map<string, int> key_to_index;   // normalized key -> index in store
+    RadixTrie trie;
+
+    SuggestionIndex() { trie.clear(); }
+};
 
 // Insert key into trie and update suggestion store; returns index in store
-int insert_suggestion(const string &raw_key, uint64_t timestamp = 0) {
+int index_insert(SuggestionIndex &ix, const string &raw_key, uint64_t timestamp) {
     string key = to_lower_normalize(raw_key);
-    lock_guard<std::mutex> lg(store_mutex);
     int idx;
-    auto it = key_to_index.find(key);
-    if (it != key_to_index.end()) {
+    auto it = ix.key_to_index.find(key);
+    if (it != ix.key_to_index.end()) {
         // exists -> increment freq and update ts
         idx = it->second;
-        suggestion_store[idx].freq += 1;
-        suggestion_store[idx].last_ts = timestamp;
+        ix.store[idx].freq += 1;
+        ix.store[idx].last_ts = timestamp;
     } else {
-        idx = (int)suggestion_store.size();
-        suggestion_store.push_back({raw_key, 1, timestamp});
-        key_to_index.emplace(key, idx);
+        idx = (int)ix.store.size();
+        ix.store.push_back({raw_key, 1, timestamp});
+        ix.key_to_index.emplace(key, idx);
     }
     // insert into trie and update caches along the path
-    TrieNode* node = root;
-    // lock-free traversal not safe for inserts; we will use node mutexes when updating
-    string norm = key;
-    for (char ch : norm) {
-        std::unique_lock<std::shared_mutex> lock(node->node_mutex);
-        TrieNode* next;
-        auto itc = node->children.find(ch);
-        if (itc == node->children.end()) {
-            next = make_node();
-            node->children[ch] = next;
-        } else next = itc->second;
-        // update cache at node
-        merge_into_cache(node->top_cache, idx);
-        lock.unlock();
-        node = next;
-    }
-    {
-        std::unique_lock<std::shared_mutex> lock(node->node_mutex);
-        node->is_end = true;
-        node->suggestion_indices.push_back(idx);
-        merge_into_cache(node->top_cache, idx);
-    }
+    ix.trie.insert(key, idx, ix.store);
     return idx;
 }
 
 // Delete a suggestion (decrement frequency, optionally remove if freq==0)
-bool delete_suggestion(const string &raw_key) {
+bool index_delete(SuggestionIndex &ix, const string &raw_key) {
     string key = to_lower_normalize(raw_key);
-    lock_guard<std::mutex> lg(store_mutex);
-    auto it = key_to_index.find(key);
-    if (it == key_to_index.end()) return false;
+    auto it = ix.key_to_index.find(key);
+    if (it == ix.key_to_index.end()) return false;
     int idx = it->second;
+    vector<uint32_t> path = ix.trie.path_to(key);
     // decrement frequency
-    if (suggestion_store[idx].freq > 1) {
-        suggestion_store[idx].freq -= 1;
-        suggestion_store[idx].last_ts = 0;
-        // Ideally update caches along path (we skip for simplicity)
+    if (ix.store[idx].freq > 1) {
+        ix.store[idx].freq -= 1;
+        ix.store[idx].last_ts = 0;
+        ix.trie.refresh_path(path, idx, ix.store);
         return true;
     }
     // freq==1 -> remove suggestion entirely
-    suggestion_store[idx].freq = 0;
-    // mark removed; don't reindex suggestion_store to avoid reindexing costs
-    suggestion_store[idx].key = ""; // mark deleted
-    key_to_index.erase(it);
-    // Note: trie cleanup (removing nodes) is complex and optional;
-    // We'll leave nodes present but entries removed from suggestion_indices and caches lazily.
+    ix.store[idx].freq = 0;
+    // mark removed; don't reindex the store to avoid reindexing costs
+    ix.store[idx].key = ""; // mark deleted
+    ix.key_to_index.erase(it);
+    // Nodes stay (trie cleanup is optional); the entry leaves its end list and every cache
+    if (!path.empty()) ix.trie.remove_end(path.back(), idx);
+    ix.trie.refresh_path(path, idx, ix.store);
     return true;
 }
 
-// Find node corresponding to prefix (normalized), return nullptr if not found
-TrieNode* find_node_for_prefix(const string &prefix) {
-    TrieNode* node = root;
-    string norm = to_lower_normalize(prefix);
-    for (char ch : norm) {
-        std::shared_lock<std::shared_mutex> lock(node->node_mutex);
-        auto it = node->children.find(ch);
-        if (it == node->children.end()) return nullptr;
-        node = it->second;
-    }
-    return node;
+// Find node corresponding to prefix (normalized), return NO_NODE if not found
+uint32_t find_node_for_prefix(const SuggestionIndex &ix, const string &prefix) {
+    return ix.trie.find_prefix(to_lower_normalize(prefix));
 }
 
-// Gather top suggestions under node using cache, fallback to DFS if necessary
-vector<int> gather_top_suggestions(TrieNode* node, int top_k) {
+// Gather top suggestions under node using cache, fallback to BFS if necessary
+vector<int> gather_top_suggestions(const SuggestionIndex &ix, uint32_t node, int top_k) {
     vector<int> result;
-    if (!node) return result;
-    { // try using cache
-        std::shared_lock<std::shared_mutex> lock(node->node_mutex);
-        for (int idx : node->top_cache) {
-            // filter out deleted entries
-            if (idx >= 0 && idx < (int)suggestion_store.size() && !suggestion_store[idx].key.empty()) {
-                result.push_back(idx);
-                if ((int)result.size() >= top_k) break;
-            }
+    if (node == NO_NODE) return result;
+    const vector<Suggestion> &store = ix.store;
+    const RadixTrie &trie = ix.trie;
+    // try using cache
+    const int *cache = trie.cache(node);
+    for (int i = 0; i < trie.nodes[node].cache_count; ++i) {
+        int idx = cache[i];
+        // filter out deleted entries
+        if (idx >= 0 && idx < (int)store.size() && !store[idx].key.empty()) {
+            result.push_back(idx);
+            if ((int)result.size() >= top_k) break;
         }
-        if ((int)result.size() >= top_k) return result;
-    }
-    // Cache insufficient -> do DFS to find more suggestions
-    // BFS traversal collecting suggestion indices and using priority by score
-    priority_queue<int, vector<int>, function<bool(int,int)>> pq(
-        [](int a, int b){ return suggestion_cmp_idx(a,b); } // not used but prepare
-    );
-    // we'll use a vector and then sort
+    }
+    if ((int)result.size() >= top_k) return result;
+    // Cache insufficient -> BFS collecting suggestion indices, then sort by score
     vector<int> found;
-    // BFS queue
-    deque<TrieNode*> q;
+    deque<uint32_t> q;
     q.push_back(node);
     while (!q.empty() && (int)found.size() < top_k*5) { // limit exploration to avoid heavy work
-        TrieNode* cur = q.front(); q.pop_front();
-        std::shared_lock<std::shared_mutex> lock(cur->node_mutex);
+        uint32_t cur = q.front(); q.pop_front();
         // add end suggestions
-        for (int idx : cur->suggestion_indices) {
-            if (idx >= 0 && idx < (int)suggestion_store.size() && !suggestion_store[idx].key.empty())
+        for (int32_t e = trie.nodes[cur].end_head; e != -1; e = trie.end_pool[e].next) {
+            int idx = trie.end_pool[e].idx;
+            if (idx >= 0 && idx < (int)store.size() && !store[idx].key.empty())
                 found.push_back(idx);
         }
-        for (auto &p : cur->children) q.push_back(p.second);
+        trie.for_each_child(cur, [&](uint32_t c) { q.push_back(c); });
     }
-    // sort found by score and pick top_k
-    sort(found.begin(), found.end(), suggestion_cmp_idx);
+    // sort found by score and append after the (exact) cached entries, skipping the ones
+    // the BFS found again
+    sort(found.begin(), found.end(), SuggestionOrder{store});
+    size_t cached = result.size();
     for (int i = 0; i < (int)found.size() && (int)result.size() < top_k; ++i) {
+        if (find(result.begin(), result.begin() + cached, found[i]) != result.begin() + cached) continue;
         result.push_back(found[i]);
     }
     return result;
 }
 
-// Autocomplete API: returns vector of suggestion strings (top_k)
-vector<Suggestion> autocomplete(const string &prefix, int top_k) {
+// Top_k suggestions for prefix
+vector<Suggestion> index_autocomplete(const SuggestionIndex &ix, const string &prefix, int top_k) {
     vector<Suggestion> out;
-    TrieNode* node = find_node_for_prefix(prefix);
-    if (!node) return out;
-    vector<int> idxs = gather_top_suggestions(node, top_k);
+    uint32_t node = find_node_for_prefix(ix, prefix);
+    if (node == NO_NODE) return out;
+    vector<int> idxs = gather_top_suggestions(ix, node, top_k);
     for (int idx : idxs) {
-        out.push_back(suggestion_store[idx]);
+        out.push_back(ix.store[idx]);
     }
     return out;
 }
 
+// --------------------------- Locked index ---------------------------------
+
+// Default mode: a single index; writers take the lock exclusively, readers shared
+SuggestionIndex locked_index;
+std::shared_mutex index_mutex;
+
+int insert_suggestion(const string &raw_key, uint64_t timestamp = 0) {
+    std::unique_lock<std::shared_mutex> lock(index_mutex);
+    return index_insert(locked_index, raw_key, timestamp);
+}
+
+bool delete_suggestion(const string &raw_key) {
+    std::unique_lock<std::shared_mutex> lock(index_mutex);
+    return index_delete(locked_index, raw_key);
+}
+
+// Autocomplete API: returns vector of suggestion strings (top_k)
+vector<Suggestion> autocomplete(const string &prefix, int top_k) {
+    std::shared_lock<std::shared_mutex> lock(index_mutex);
+    return index_autocomplete(locked_index, prefix, top_k);
+}
+
+// --------------------------- Snapshot index -------------------------------
+
+// Lock-free reads (--snapshot), left-right style. Two copies of the index are kept:
+// readers use the copy `active` names without taking any lock, while the writer applies a
+// batch to the other copy, publishes it with one atomic store, waits for a grace period
+// and then replays the batch on the old copy. The grace period is epoch based: a reader
+// announces the current epoch in its slot before loading `active` and clears the slot when
+// done; after publishing, the writer advances the epoch and waits until no slot holds an
+// older one, at which point no reader can still be inside the old copy.
+// The price is memory for two copies and applying every write twice.
+
+struct WriteOp {
+    bool remove;        // delete instead of insert
+    string key;
+    uint64_t timestamp;
+};
+
+struct SnapshotIndex {
+    static constexpr uint64_t IDLE = UINT64_MAX;
+    struct alignas(64) ReaderSlot { atomic<uint64_t> epoch{IDLE}; };
+
+    SuggestionIndex side[2];
+    atomic<int> active{0};
+    atomic<uint64_t> epoch{1};
+    ReaderSlot readers[MAX_SNAPSHOT_READERS];
+    atomic<int> reader_count{0};
+    std::mutex writer_mutex;
+
+    // Start serving from a fully built index
+    void init(const SuggestionIndex &ix) {
+        side[0] = ix;
+        side[1] = ix;
+        active.store(0);
+    }
+
+    // Each reading thread registers once (at most MAX_SNAPSHOT_READERS) and passes its id to read
+    int register_reader() { return reader_count.fetch_add(1); }
+
+    // Run f on the current version without locking
+    template <class F> auto read(int reader, F f) {
+        ReaderSlot &slot = readers[reader];
+        slot.epoch.store(epoch.load());
+        auto result = f(side[active.load()]);
+        slot.epoch.store(IDLE, memory_order_release);
+        return result;
+    }
+
+    static void apply_op(SuggestionIndex &ix, const WriteOp &op) {
+        if (op.remove) index_delete(ix, op.key);
+        else index_insert(ix, op.key, op.timestamp);
+    }
+
+    void apply(const vector<WriteOp> &batch) {
+        lock_guard<std::mutex> lg(writer_mutex);
+        int standby = 1 - active.load();
+        for (const auto &op : batch) apply_op(side[standby], op);
+        active.store(standby);
+        uint64_t e = epoch.fetch_add(1) + 1;
+        for (int r = 0, n = reader_count.load(); r < n; ++r)
+            while (readers[r].epoch.load() < e) this_thread::yield();
+        for (const auto &op : batch) apply_op(side[1 - standby], op);
+    }
+};
+
+SnapshotIndex snapshot;
+
 // --------------------------- CSV Loading ----------------------------------
 
-bool load_csv_and_build_trie(const string &filename) {
+bool load_csv_and_build_trie(const string &filename, SuggestionIndex &ix) {
     ifstream fin(filename);
     if (!fin.is_open()) {
         cerr << "Cannot open file: " << filename << "\n";
@@ -309,79 +604,397 @@ bool load_csv_and_build_trie(const string &filename) {
         string key = name + ", " + address;
         // use current timestamp as index (monotonic)
         uint64_t ts = (uint64_t)time(nullptr);
-        insert_suggestion(key, ts);
+        index_insert(ix, key, ts);
     }
     fin.close();
     return true;
 }
 
-// --------------------------- Levenshtein (simple fallback) -----------------
-
-int levenshtein(const string &a, const string &b) {
-    int n = a.size(), m = b.size();
-    vector<int> dp(m+1);
-    for (int j=0;j<=m;++j) dp[j]=j;
-    for (int i=1;i<=n;++i) {
-        int prev = dp[0];
-        dp[0] = i;
-        for (int j=1;j<=m;++j) {
-            int cur = dp[j];
-            int cost = (a[i-1]==b[j-1]) ? 0 : 1;
-            dp[j] = min({ dp[j]+1, dp[j-1]+1, prev + cost });
-            prev = cur;
+// --------------------------- Fuzzy search ---------------------------------
+
+// Suggestions whose key starts with something within max_edits (Levenshtein) of prefix.
+// Walks the trie depth-first carrying the DP row of the query against the path so far,
+// one row per label character: row[n] is the distance from the query to the path string,
+// and a subtree is abandoned once every cell of the row exceeds max_edits, since the
+// distance can only grow from there. Each reached node whose path is within max_edits
+// contributes its cached top suggestions at the best distance seen along the path.
+// Results are ranked by distance, then by the usual score.
+struct FuzzyWalker {
+    const SuggestionIndex &ix;
+    const string &query;
+    int max_edits;
+    vector<pair<int,int>> hits;   // (distance, suggestion index)
+
+    void collect(uint32_t node, int dist) {
+        const int *cache = ix.trie.cache(node);
+        for (int i = 0; i < ix.trie.nodes[node].cache_count; ++i)
+            if (!ix.store[cache[i]].key.empty()) hits.emplace_back(dist, cache[i]);
+    }
+
+    void visit(uint32_t node, vector<int> row, int path_best) {
+        const TrieNode &nd = ix.trie.nodes[node];
+        size_t n = query.size();
+        vector<int> next(n + 1);
+        for (uint32_t k = 0; k < nd.label_len; ++k) {
+            char c = ix.trie.label_pool[nd.label_off + k];
+            next[0] = row[0] + 1;
+            int row_min = next[0];
+            for (size_t j = 1; j <= n; ++j) {
+                next[j] = min({row[j] + 1, next[j - 1] + 1, row[j - 1] + (query[j - 1] != c)});
+                row_min = min(row_min, next[j]);
+            }
+            row.swap(next);
+            path_best = min(path_best, row[n]);
+            if (row_min > max_edits) break;
         }
+        if (path_best <= max_edits) collect(node, path_best);
+        if (*min_element(row.begin(), row.end()) > max_edits) return;
+        ix.trie.for_each_child(node, [&](uint32_t c) { visit(c, row, path_best); });
     }
-    return dp[m];
-}
+};
 
-// Fuzzy fallback: scan all suggestions and return those with small edit distance (only for small datasets)
-vector<Suggestion> fuzzy_suggest(const string &prefix, int top_k) {
+vector<Suggestion> fuzzy_suggest(const SuggestionIndex &ix, const string &prefix, int top_k, int max_edits = 2) {
     string norm = to_lower_normalize(prefix);
-    vector<pair<int,int>> candidates; // distance, idx
-    for (int i=0;i<(int)suggestion_store.size();++i) {
-        if (suggestion_store[i].key.empty()) continue;
-        string k = to_lower_normalize(suggestion_store[i].key);
-        int d = levenshtein(norm, k.substr(0, min((int)k.size(), (int)norm.size()+2)));
-        candidates.emplace_back(d, i);
-    }
-    sort(candidates.begin(), candidates.end());
+    FuzzyWalker walker{ix, norm, max_edits, {}};
+    vector<int> row(norm.size() + 1);
+    iota(row.begin(), row.end(), 0);
+    walker.visit(0, row, (int)norm.size());
+    auto &hits = walker.hits;
+    SuggestionOrder by_score{ix.store};
+    sort(hits.begin(), hits.end(), [&](const pair<int,int> &a, const pair<int,int> &b) {
+        if (a.first != b.first) return a.first < b.first;
+        return by_score(a.second, b.second);
+    });
     vector<Suggestion> out;
-    for (int i=0;i<(int)candidates.size() && (int)out.size()<top_k; ++i) {
-        out.push_back(suggestion_store[candidates[i].second]);
+    unordered_set<int> seen;
+    for (int i=0;i<(int)hits.size() && (int)out.size()<top_k; ++i) {
+        if (seen.insert(hits[i].second).second) out.push_back(ix.store[hits[i].second]);
     }
     return out;
 }
 
-// --------------------------- Main (CLI) -----------------------------------
+// --------------------------- Persistent index -----------------------------
 
-void print_usage() {
-    cerr << "Usage: autocomplete_trie data.csv [--top K] [--fuzzy]\n";
-    cerr << "Then type prefixes interactively to get suggestions (type exit to quit).\n";
+// Single-file snapshot of a SuggestionIndex for read-only serving. Every section is a flat
+// array that is used in place once the file is mmapped, so startup costs one mmap call.
+// Layout: header, nodes, suggestions, then the 32-bit arrays (child ids, caches, end
+// lists) and the byte arrays (child first bytes, edge labels, key strings). Deleted
+// entries are dropped and the live ones renumbered in their original order, so scores,
+// tie-breaks and children order all carry over and answers match the in-memory index.
+
+struct IndexFileHeader {
+    char magic[8];                  // "ACIDX001"
+    uint32_t node_count, suggestion_count;
+    uint32_t cache_per_node, reserved;
+    uint64_t child_count, cache_entries, end_entries, label_bytes, key_bytes;
+};
+static const char INDEX_MAGIC[8] = {'A','C','I','D','X','0','0','1'};
+
+struct FlatNode {
+    uint32_t label_off, label_len;  // into the label bytes
+    uint32_t child_off, child_count; // sorted by first label byte
+    uint32_t cache_off, cache_count; // top suggestions of the subtree, best first
+    uint32_t end_off, end_count;     // suggestions ending here
+};
+
+struct FlatSuggestion {
+    uint64_t key_off;
+    uint32_t key_len, reserved;
+    uint64_t freq, last_ts;
+};
+
+template <class T> static void write_array(ofstream &out, const vector<T> &v) {
+    out.write(reinterpret_cast<const char*>(v.data()), v.size() * sizeof(T));
 }
 
-int main(int argc, char** argv) {
-    ios::sync_with_stdio(false);
-    cin.tie(nullptr);
+bool write_index_file(const SuggestionIndex &ix, const string &filename, string &err) {
+    const RadixTrie &trie = ix.trie;
+    vector<uint32_t> renumber(ix.store.size(), UINT32_MAX);
+    vector<FlatSuggestion> sugg;
+    string keys;
+    for (size_t i = 0; i < ix.store.size(); ++i) {
+        const Suggestion &s = ix.store[i];
+        if (s.key.empty()) continue;
+        renumber[i] = (uint32_t)sugg.size();
+        sugg.push_back({keys.size(), (uint32_t)s.key.size(), 0, s.freq, s.last_ts});
+        keys += s.key;
+    }
+    vector<FlatNode> nodes(trie.nodes.size());
+    vector<uint32_t> child_nodes, cache, ends;
+    vector<unsigned char> child_chars;
+    for (uint32_t n = 0; n < trie.nodes.size(); ++n) {
+        FlatNode &f = nodes[n];
+        f.label_off = trie.nodes[n].label_off;
+        f.label_len = trie.nodes[n].label_len;
+        f.child_off = (uint32_t)child_nodes.size();
+        trie.for_each_child(n, [&](uint32_t c) {
+            child_nodes.push_back(c);
+            child_chars.push_back(trie.label_pool[trie.nodes[c].label_off]);
+        });
+        f.child_count = (uint32_t)child_nodes.size() - f.child_off;
+        f.cache_off = (uint32_t)cache.size();
+        const int *c = trie.cache(n);
+        for (int i = 0; i < trie.nodes[n].cache_count; ++i)
+            if (renumber[c[i]] != UINT32_MAX) cache.push_back(renumber[c[i]]);
+        f.cache_count = (uint32_t)cache.size() - f.cache_off;
+        f.end_off = (uint32_t)ends.size();
+        for (int32_t e = trie.nodes[n].end_head; e != -1; e = trie.end_pool[e].next)
+            if (renumber[trie.end_pool[e].idx] != UINT32_MAX) ends.push_back(renumber[trie.end_pool[e].idx]);
+        // end lists are built newest first; keep insertion order on disk
+        reverse(ends.begin() + f.end_off, ends.end());
+        f.end_count = (uint32_t)ends.size() - f.end_off;
+    }
+    IndexFileHeader h{};
+    memcpy(h.magic, INDEX_MAGIC, 8);
+    h.node_count = (uint32_t)nodes.size();
+    h.suggestion_count = (uint32_t)sugg.size();
+    h.cache_per_node = (uint32_t)MAX_CACHE_PER_NODE;
+    h.child_count = child_nodes.size();
+    h.cache_entries = cache.size();
+    h.end_entries = ends.size();
+    h.label_bytes = trie.label_pool.size();
+    h.key_bytes = keys.size();
 
-    if (argc < 2) { print_usage(); return 1; }
-    string datafile = argv[1];
-    int top_k = 5;
-    bool fuzzy = false;
-    for (int i=2;i<argc;++i) {
-        string s = argv[i];
-        if (s == "--top" && i+1<argc) top_k = stoi(argv[++i]);
-        else if (s == "--fuzzy") fuzzy = true;
+    ofstream fout(filename, ios::binary);
+    if (!fout.is_open()) { err = "Cannot open file for writing: " + filename; return false; }
+    fout.write(reinterpret_cast<const char*>(&h), sizeof(h));
+    write_array(fout, nodes);
+    write_array(fout, sugg);
+    write_array(fout, child_nodes);
+    write_array(fout, cache);
+    write_array(fout, ends);
+    write_array(fout, child_chars);
+    fout.write(trie.label_pool.data(), trie.label_pool.size());
+    fout.write(keys.data(), keys.size());
+    if (!fout) { err = "Write failed: " + filename; return false; }
+    return true;
+}
+
+struct MappedIndex {
+    const IndexFileHeader *header = nullptr;
+    const FlatNode *nodes = nullptr;
+    const FlatSuggestion *sugg = nullptr;
+    const uint32_t *child_nodes = nullptr, *cache = nullptr, *ends = nullptr;
+    const unsigned char *child_chars = nullptr;
+    const char *labels = nullptr, *keys = nullptr;
+    void *map = nullptr;
+    size_t map_size = 0;
+
+    MappedIndex() = default;
+    MappedIndex(const MappedIndex&) = delete;
+    MappedIndex& operator=(const MappedIndex&) = delete;
+    ~MappedIndex() { if (map) munmap(map, map_size); }
+
+    bool open(const string &filename, string &err) {
+        int fd = ::open(filename.c_str(), O_RDONLY);
+        if (fd < 0) { err = "Cannot open index: " + filename; return false; }
+        struct stat st;
+        if (fstat(fd, &st) != 0 || (size_t)st.st_size < sizeof(IndexFileHeader)) {
+            ::close(fd);
+            err = "Index too small: " + filename;
+            return false;
+        }
+        map_size = (size_t)st.st_size;
+        map = mmap(nullptr, map_size, PROT_READ, MAP_SHARED, fd, 0);
+        ::close(fd);
+        if (map == MAP_FAILED) { map = nullptr; err = "mmap failed: " + filename; return false; }
+        header = static_cast<const IndexFileHeader*>(map);
+        const IndexFileHeader &h = *header;
+        size_t need = sizeof(IndexFileHeader) + (size_t)h.node_count * sizeof(FlatNode) +
+                      (size_t)h.suggestion_count * sizeof(FlatSuggestion) +
+                      (h.child_count + h.cache_entries + h.end_entries) * sizeof(uint32_t) +
+                      h.child_count + h.label_bytes + h.key_bytes;
+        if (memcmp(h.magic, INDEX_MAGIC, 8) != 0 || h.node_count == 0 || map_size < need) {
+            err = "Not a valid autocomplete index: " + filename;
+            return false;
+        }
+        const char *p = static_cast<const char*>(map) + sizeof(IndexFileHeader);
+        nodes = reinterpret_cast<const FlatNode*>(p);               p += (size_t)h.node_count * sizeof(FlatNode);
+        sugg = reinterpret_cast<const FlatSuggestion*>(p);          p += (size_t)h.suggestion_count * sizeof(FlatSuggestion);
+        child_nodes = reinterpret_cast<const uint32_t*>(p);         p += h.child_count * sizeof(uint32_t);
+        cache = reinterpret_cast<const uint32_t*>(p);               p += h.cache_entries * sizeof(uint32_t);
+        ends = reinterpret_cast<const uint32_t*>(p);                p += h.end_entries * sizeof(uint32_t);
+        child_chars = reinterpret_cast<const unsigned char*>(p);    p += h.child_count;
+        labels = p;                                                 p += h.label_bytes;
+        keys = p;
+        return true;
     }
 
-    // Initialize root
-    root = make_node();
+    string_view key(uint32_t s) const { return {keys + sugg[s].key_off, sugg[s].key_len}; }
 
-    cout << "Loading data from " << datafile << " ...\n";
-    if (!load_csv_and_build_trie(datafile)) {
-        cerr << "Failed to load CSV\n";
-        return 1;
+    Suggestion suggestion(uint32_t s) const { return {string(key(s)), sugg[s].freq, sugg[s].last_ts}; }
+
+    // Same order as SuggestionOrder
+    bool better(uint32_t a, uint32_t b) const {
+        uint64_t ra = (sugg[a].freq << 32) | (sugg[a].last_ts & 0xffffffff);
+        uint64_t rb = (sugg[b].freq << 32) | (sugg[b].last_ts & 0xffffffff);
+        if (ra != rb) return ra > rb;
+        if (key(a) != key(b)) return key(a) < key(b);
+        return a < b;
+    }
+
+    uint32_t find_child(uint32_t n, unsigned char c) const {
+        const unsigned char *b = child_chars + nodes[n].child_off, *e = b + nodes[n].child_count;
+        const unsigned char *it = lower_bound(b, e, c);
+        return it != e && *it == c ? child_nodes[it - child_chars] : NO_NODE;
+    }
+
+    uint32_t find_prefix(const string &norm) const {
+        uint32_t cur = 0;
+        size_t i = 0;
+        while (i < norm.size()) {
+            uint32_t child = find_child(cur, norm[i]);
+            if (child == NO_NODE) return NO_NODE;
+            size_t m = min<size_t>(nodes[child].label_len, norm.size() - i);
+            if (norm.compare(i, m, labels + nodes[child].label_off, m) != 0) return NO_NODE;
+            cur = child;
+            i += m;
+        }
+        return cur;
+    }
+
+    // Mirrors index_autocomplete: node cache first, bounded BFS when top_k exceeds it
+    vector<Suggestion> autocomplete(const string &prefix, int top_k) const {
+        vector<Suggestion> out;
+        uint32_t node = find_prefix(to_lower_normalize(prefix));
+        if (node == NO_NODE) return out;
+        const FlatNode &nd = nodes[node];
+        int cached = min<int>(nd.cache_count, top_k);
+        for (int i = 0; i < cached; ++i) out.push_back(suggestion(cache[nd.cache_off + i]));
+        if (cached >= top_k) return out;
+        vector<uint32_t> found;
+        deque<uint32_t> q;
+        q.push_back(node);
+        while (!q.empty() && (int)found.size() < top_k*5) {
+            uint32_t cur = q.front(); q.pop_front();
+            found.insert(found.end(), ends + nodes[cur].end_off, ends + nodes[cur].end_off + nodes[cur].end_count);
+            for (uint32_t c = 0; c < nodes[cur].child_count; ++c) q.push_back(child_nodes[nodes[cur].child_off + c]);
+        }
+        sort(found.begin(), found.end(), [&](uint32_t a, uint32_t b) { return better(a, b); });
+        const uint32_t *cache_begin = cache + nd.cache_off, *cache_end = cache_begin + cached;
+        for (int i = 0; i < (int)found.size() && (int)out.size() < top_k; ++i)
+            if (find(cache_begin, cache_end, found[i]) == cache_end) out.push_back(suggestion(found[i]));
+        return out;
     }
-    cout << "Loaded " << suggestion_store.size() << " suggestions into trie.\n";
+};
+
+// --------------------------- Read benchmark -------------------------------
+
+// Autocomplete throughput with 1, 2, 4, ... max_threads reader threads cycling through
+// prefixes while one writer keeps inserting new entries in batches
+void run_read_benchmark(const vector<string> &prefixes, int max_threads, int top_k, bool use_snapshot) {
+    vector<int> reader_ids(max_threads);
+    if (use_snapshot) for (int &id : reader_ids) id = snapshot.register_reader();
+    uint64_t next_key = 0;
+    double base_qps = 0;
+    for (int t = 1;; t = min(t * 2, max_threads)) {
+        atomic<bool> stop{false};
+        atomic<uint64_t> queries{0}, results{0};
+        uint64_t writes = 0;
+        vector<thread> pool;
+        for (int r = 0; r < t; ++r) pool.emplace_back([&, r] {
+            uint64_t done = 0;
+            size_t found = 0;
+            for (size_t i = r; !stop.load(memory_order_relaxed); ++i, ++done) {
+                const string &q = prefixes[i % prefixes.size()];
+                if (use_snapshot)
+                    found += snapshot.read(reader_ids[r], [&](const SuggestionIndex &ix) {
+                        return index_autocomplete(ix, q, top_k).size();
+                    });
+                else found += autocomplete(q, top_k).size();
+            }
+            queries += done;
+            results += found;
+        });
+        thread writer([&] {
+            while (!stop.load()) {
+                vector<WriteOp> batch;
+                for (size_t j = 0; j < BENCH_WRITE_BATCH; ++j, ++next_key)
+                    batch.push_back({false, "Bench Writer " + to_string(next_key) + ", Test Street", next_key});
+                if (use_snapshot) snapshot.apply(batch);
+                else for (auto &op : batch) insert_suggestion(op.key, op.timestamp);
+                writes += batch.size();
+                this_thread::sleep_for(chrono::milliseconds(1));
+            }
+        });
+        this_thread::sleep_for(chrono::seconds(1));
+        stop = true;
+        for (auto &th : pool) th.join();
+        writer.join();
+        double qps = (double)queries.load();
+        if (t == 1) base_qps = qps;
+        cout << "  " << setw(3) << t << " threads: " << fixed << setprecision(0) << qps << " queries/s ("
+             << setprecision(2) << (base_qps > 0 ? qps / base_qps : 0.0) << "x, "
+             << (qps > 0 ? results.load() / qps : 0.0) << " suggestions each), " << writes << " inserts\n";
+        cout.unsetf(ios::fixed);
+        if (t == max_threads) break;
+    }
+}
+
+// --------------------------- Stress test ----------------------------------
+
+// Mixed query / insert / delete traffic on the locked index (frequencies skewed toward
+// the first entries loaded). Every STRESS_CHECK_EVERY operations the suggestions for a
+// random prefix are compared with a full scan of the live entries, once at top_k capped
+// to the cache size and once well past it. Past the cache only the cached head is exact;
+// the tail must still be distinct, live, and fill the answer when enough entries match.
+void run_stress(int ops, int top_k) {
+    vector<string> keys;
+    for (auto &s : locked_index.store) if (!s.key.empty()) keys.push_back(s.key);
+    if (keys.empty()) return;
+    int k = min<int>(top_k, (int)MAX_CACHE_PER_NODE); // beyond the cache answers are best effort
+    int wide_k = 3 * (int)MAX_CACHE_PER_NODE;
+    mt19937_64 rng(12345);
+    size_t queries = 0, inserts = 0, deletes = 0, checks = 0, mismatches = 0;
+    double check_ms = 0;
+    auto t0 = chrono::steady_clock::now();
+    for (int op = 0; op < ops; ++op) {
+        const string &key = keys[min(rng() % keys.size(), rng() % keys.size())];
+        int r = (int)(rng() % 10);
+        if (r < 5) { autocomplete(key.substr(0, 1 + rng() % min<size_t>(key.size(), 8)), top_k); ++queries; }
+        else if (r < 8) { insert_suggestion(key, (uint64_t)op); ++inserts; }
+        else { delete_suggestion(key); ++deletes; }
+        if ((op + 1) % STRESS_CHECK_EVERY != 0) continue;
+        auto c0 = chrono::steady_clock::now();
+        string norm = to_lower_normalize(keys[rng() % keys.size()]);
+        string prefix = norm.substr(0, 1 + rng() % min<size_t>(norm.size(), 6));
+        vector<int> expect;
+        for (auto &kv : locked_index.key_to_index)
+            if (kv.first.compare(0, prefix.size(), prefix) == 0) expect.push_back(kv.second);
+        size_t head = min<size_t>(expect.size(), MAX_CACHE_PER_NODE);
+        partial_sort(expect.begin(), expect.begin() + head, expect.end(), SuggestionOrder{locked_index.store});
+        for (int kk : {k, wide_k}) {
+            auto got = autocomplete(prefix, kk);
+            size_t m = min<size_t>(head, kk);
+            bool same = got.size() == min<size_t>(expect.size(), kk);
+            for (size_t i = 0; same && i < m; ++i) {
+                const Suggestion &e = locked_index.store[expect[i]];
+                same = got[i].key == e.key && got[i].freq == e.freq && got[i].last_ts == e.last_ts;
+            }
+            set<string> seen;
+            for (size_t i = 0; same && i < got.size(); ++i) {
+                string g = to_lower_normalize(got[i].key);
+                same = seen.insert(g).second && locked_index.key_to_index.count(g) && g.compare(0, prefix.size(), prefix) == 0;
+            }
+            ++checks;
+            if (!same) ++mismatches;
+        }
+        check_ms += chrono::duration<double, milli>(chrono::steady_clock::now() - c0).count();
+    }
+    double ms = chrono::duration<double, milli>(chrono::steady_clock::now() - t0).count() - check_ms;
+    cout << "Stress: " << ops << " ops (" << queries << " queries, " << inserts << " inserts, " << deletes
+         << " deletes) in " << fixed << setprecision(1) << ms << " ms (" << setprecision(0)
+         << (ms > 0 ? ops / ms * 1000.0 : 0.0) << " ops/s)\n";
+    cout.unsetf(ios::fixed);
+    cout << "Checked top " << k << " and top " << wide_k << " of " << checks / 2 << " random prefixes against a full scan: "
+         << mismatches << " mismatches\n";
+}
+
+// --------------------------- Main (CLI) -----------------------------------
+
+// Interactive prefix queries; fuzzy (optional) is tried when complete finds nothing
+void run_repl(const function<vector<Suggestion>(const string&)> &complete,
+              const function<vector<Suggestion>(const string&)> &fuzzy) {
     cout << "Ready. Enter prefix queries (type 'exit' or blank line to quit).\n";
 
     string line;
@@ -392,9 +1005,9 @@ int main(int argc, char** argv) {
         if (line.empty()) break;
         if (line == "exit" || line == "quit") break;
         // if user types a number to select suggestion, not implemented here
-        auto suggestions = autocomplete(line, top_k);
+        auto suggestions = complete(line);
         if (suggestions.empty() && fuzzy) {
-            auto f = fuzzy_suggest(line, top_k);
+            auto f = fuzzy(line);
             if (!f.empty()) {
                 cout << "Fuzzy suggestions:\n";
                 for (auto &s : f) cout << "  " << s.key << "  (freq=" << s.freq << ")\n";
@@ -412,5 +1025,122 @@ int main(int argc, char** argv) {
     }
 
     cout << "Exiting.\n";
+}
+
+void print_usage() {
+    cerr << "Usage: autocomplete_trie data.csv [--top K] [--fuzzy [--max-edits D]] [--snapshot] [--bench PREFIX_FILE [--threads T]] [--stress OPS]\n";
+    cerr << "       autocomplete_trie data.csv --build-index FILE\n";
+    cerr << "       autocomplete_trie --index FILE [--top K]\n";
+    cerr << "Then type prefixes interactively to get suggestions (type exit to quit).\n";
+    cerr << "  --fuzzy     when a prefix has no match, suggest entries within D edits of it (default 2)\n";
+    cerr << "  --snapshot  serve reads lock-free from published snapshots (uses twice the memory)\n";
+    cerr << "  --build-index  write the loaded trie with its top-k caches to FILE and exit\n";
+    cerr << "  --index        serve prefix queries from a built FILE, memory-mapped (no CSV load)\n";
+    cerr << "  --stress    run OPS mixed queries/inserts/deletes, checking suggestions against a full scan\n";
+    cerr << "  --bench     measure read throughput on the prefixes in PREFIX_FILE (one per line)\n";
+    cerr << "              with 1..T threads (default: hardware threads) under concurrent inserts\n";
+}
+
+int main(int argc, char** argv) {
+    ios::sync_with_stdio(false);
+    cin.tie(nullptr);
+
+    if (argc < 2) { print_usage(); return 1; }
+    string datafile = argv[1][0] == '-' ? "" : argv[1];
+    int top_k = 5;
+    bool fuzzy = false;
+    int max_edits = 2;
+    bool use_snapshot = false;
+    string bench_file;
+    int stress_ops = 0;
+    string build_index_file, index_file;
+    int threads = max(1u, thread::hardware_concurrency());
+    for (int i=datafile.empty() ? 1 : 2;i<argc;++i) {
+        string s = argv[i];
+        if (s == "--top" && i+1<argc) top_k = stoi(argv[++i]);
+        else if (s == "--fuzzy") fuzzy = true;
+        else if (s == "--max-edits" && i+1<argc) max_edits = max(0, stoi(argv[++i]));
+        else if (s == "--snapshot") use_snapshot = true;
+        else if (s == "--bench" && i+1<argc) bench_file = argv[++i];
+        else if (s == "--stress" && i+1<argc) stress_ops = stoi(argv[++i]);
+        else if (s == "--threads" && i+1<argc) threads = max(1, stoi(argv[++i]));
+        else if (s == "--build-index" && i+1<argc) build_index_file = argv[++i];
+        else if (s == "--index" && i+1<argc) index_file = argv[++i];
+    }
+    threads = min(threads, MAX_SNAPSHOT_READERS - 1); // reader slot 0 is the REPL
+
+    if (!index_file.empty()) {
+        MappedIndex mapped;
+        string err;
+        auto t0 = chrono::steady_clock::now();
+        if (!mapped.open(index_file, err)) { cerr << err << "\n"; return 1; }
+        double ms = chrono::duration<double, milli>(chrono::steady_clock::now() - t0).count();
+        cout << "Mapped " << mapped.header->suggestion_count << " suggestions (" << mapped.header->node_count
+             << " nodes) from " << index_file << " in " << ms << " ms.\n";
+        if (fuzzy) cerr << "Note: --fuzzy is not available with --index\n";
+        run_repl([&](const string &q) { return mapped.autocomplete(q, top_k); }, nullptr);
+        return 0;
+    }
+    if (datafile.empty()) { print_usage(); return 1; }
+    cout << "Loading data from " << datafile << " ...\n";
+    if (!load_csv_and_build_trie(datafile, locked_index)) {
+        cerr << "Failed to load CSV\n";
+        return 1;
+    }
+    const RadixTrie &trie = locked_index.trie;
+    cout << "Loaded " << locked_index.store.size() << " suggestions into trie ("
+         << trie.nodes.size() << " nodes, " << fixed << setprecision(1)
+         << trie.memory_bytes() / 1048576.0 << " MB).\n";
+    cout.unsetf(ios::fixed);
+    if (!build_index_file.empty()) {
+        string err;
+        auto t0 = chrono::steady_clock::now();
+        if (!write_index_file(locked_index, build_index_file, err)) { cerr << err << "\n"; return 1; }
+        double ms = chrono::duration<double, milli>(chrono::steady_clock::now() - t0).count();
+        cout << "Index written to " << build_index_file << " in " << fixed << setprecision(1) << ms << " ms.\n";
+        cout.unsetf(ios::fixed);
+        return 0;
+    }
+    if (stress_ops > 0) {
+        run_stress(stress_ops, top_k);
+        return 0;
+    }
+    int repl_reader = 0;
+    if (use_snapshot) {
+        snapshot.init(locked_index);
+        locked_index = SuggestionIndex();
+        repl_reader = snapshot.register_reader();
+        cout << "Serving lock-free snapshot reads.\n";
+    }
+
+    if (!bench_file.empty()) {
+        ifstream fin(bench_file);
+        if (!fin.is_open()) { cerr << "Cannot open file: " << bench_file << "\n"; return 1; }
+        vector<string> prefixes;
+        string line;
+        while (getline(fin, line)) { trim(line); if (!line.empty()) prefixes.push_back(line); }
+        if (prefixes.empty()) { cerr << "No prefixes in " << bench_file << "\n"; return 1; }
+        cout << "Read benchmark (" << (use_snapshot ? "snapshot" : "locked") << ", " << prefixes.size()
+             << " prefixes, top " << top_k << "):\n";
+        run_read_benchmark(prefixes, threads, top_k, use_snapshot);
+        return 0;
+    }
+
+    function<vector<Suggestion>(const string&)> complete, fuzzy_fn;
+    if (use_snapshot) {
+        complete = [&](const string &q) {
+            return snapshot.read(repl_reader, [&](const SuggestionIndex &ix) { return index_autocomplete(ix, q, top_k); });
+        };
+        if (fuzzy) fuzzy_fn = [&](const string &q) {
+            return snapshot.read(repl_reader, [&](const SuggestionIndex &ix) { return fuzzy_suggest(ix, q, top_k, max_edits); });
+        };
+    } else {
+        complete = [&](const string &q) { return autocomplete(q, top_k); };
+        if (fuzzy) fuzzy_fn = [&](const string &q) {
+            std::shared_lock<std::shared_mutex> lock(index_mutex);
+            return fuzzy_suggest(locked_index, q, top_k, max_edits);
+        };
+    }
+    run_repl(complete, fuzzy_fn);
     return 0;
 }
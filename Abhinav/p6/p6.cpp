@@ -1,12 +1,19 @@
 // interval_scheduling_or.cpp
 // Interval Scheduling (Greedy) for scheduling maximum number of surgeries in one OR.
+// Also: maximum surgeries across K identical ORs (--rooms K) and the minimum number of
+// ORs that fits every request (--partition), and the maximum total priority in one OR
+// when requests carry a weight column (--weighted). --serve then keeps the schedule as a
+// live booking book answering CAN_BOOK / BOOK / CANCEL from stdin.
 //
 // Compile: g++ -std=c++17 -O2 -o interval_scheduling_or interval_scheduling_or.cpp
 //
 // Usage: ./interval_scheduling_or surgeries.csv [--min-duration M] [--max-duration M]
-//        [--output out.csv] [--verbose]
+//        [--rooms K | --partition | --weighted] [--output out.csv] [--verbose]
+//        ./interval_scheduling_or --synthetic N [mode flags]   (benchmark on N random requests)
+//        ./interval_scheduling_or [surgeries.csv] [mode flags] --serve
 //
 // Input CSV must have header including: request_id,start,end,duration_minutes
+// and optionally weight (or priority / revenue; default 1)
 // where start/end are ISO datetimes like "2025-12-15 08:30:00" or "2025-12-15 08:30"
 //
 // Output: scheduled_surgeries.csv (by default) listing selected intervals in chronological order.
@@ -94,6 +101,7 @@ struct Interval {
     int duration_minutes;
     // optional: priority or weight
     double weight = 1.0;
+    int room = 0;   // assigned OR (multi-room modes)
 };
 
 // -------------------------- CSV Parsing -----------------------------------
@@ -158,6 +166,7 @@ bool load_intervals_from_csv(const string &filename, vector<Interval> &out, stri
     int start_col = find_col({"start","start_time","starttime","begin"});
     int end_col = find_col({"end","end_time","endtime","finish"});
     int dur_col = find_col({"duration_minutes","duration","duration_min","minutes"});
+    int weight_col = find_col({"weight","priority","revenue","score"});
     if (id_col == -1 || start_col == -1 || end_col == -1) {
         err = "CSV header must include request_id, start, and end columns (names may vary). Found columns: ";
         for (auto &p : col_index) err += p.first + " ";
@@ -175,6 +184,7 @@ bool load_intervals_from_csv(const string &filename, vector<Interval> &out, stri
         string start_s = (start_col < (int)fields.size()) ? fields[start_col] : "";
         string end_s = (end_col < (int)fields.size()) ? fields[end_col] : "";
         string dur_s = (dur_col < (int)fields.size()) ? fields[dur_col] : "";
+        string weight_s = (weight_col != -1 && weight_col < (int)fields.size()) ? fields[weight_col] : "";
         time_t ts, te;
         if (!parse_iso_datetime(start_s, ts)) {
             cerr << "Warning: failed to parse start time on line " << line_no << ": '" << start_s << "'. Skipping.\n";
@@ -197,6 +207,10 @@ bool load_intervals_from_csv(const string &filename, vector<Interval> &out, stri
         iv.start = ts;
         iv.end = te;
         iv.duration_minutes = dur;
+        if (!weight_s.empty()) {
+            try { iv.weight = stod(weight_s); }
+            catch(...) { cerr << "Warning: bad weight on line " << line_no << ", using 1.\n"; }
+        }
         out.push_back(iv);
     }
     fin.close();
@@ -222,6 +236,90 @@ vector<Interval> schedule_max_nonoverlapping(vector<Interval> intervals) {
     return chosen;
 }
 
+// Weighted interval scheduling: the non-overlapping subset of maximum total weight in one
+// room. With requests sorted by end, best[j] = max(best[j-1], w_j + best[p(j)]), where p(j)
+// is how many requests end no later than request j starts. Instead of a binary search per
+// request, p is filled in one sweep over the requests in start order while a pointer
+// advances through end order. O(n log n) for the sorts, O(n) for the DP itself.
+// A row whose end is not after its start (the loader only checks duration_minutes) would
+// count itself as ended, so p(j) is capped at j's own end-order position.
+vector<Interval> schedule_max_weight(vector<Interval> intervals, double &total_weight) {
+    sort(intervals.begin(), intervals.end(), [](const Interval &a, const Interval &b) {
+        if (a.end != b.end) return a.end < b.end;
+        return a.start < b.start;
+    });
+    size_t n = intervals.size();
+    vector<size_t> by_start(n);
+    iota(by_start.begin(), by_start.end(), 0);
+    sort(by_start.begin(), by_start.end(), [&](size_t a, size_t b) { return intervals[a].start < intervals[b].start; });
+    vector<size_t> p(n);
+    size_t ended = 0;
+    for (size_t j : by_start) {
+        while (ended < n && intervals[ended].end <= intervals[j].start) ++ended;
+        p[j] = min(ended, j);
+    }
+    vector<double> best(n + 1, 0.0);
+    for (size_t j = 1; j <= n; ++j)
+        best[j] = max(best[j - 1], intervals[j - 1].weight + best[p[j - 1]]);
+    total_weight = best[n];
+    // Walk back: request j was taken exactly when taking it beats skipping it
+    vector<Interval> chosen;
+    for (size_t j = n; j > 0;) {
+        if (intervals[j - 1].weight + best[p[j - 1]] > best[j - 1]) {
+            chosen.push_back(intervals[j - 1]);
+            j = p[j - 1];
+        } else --j;
+    }
+    reverse(chosen.begin(), chosen.end());
+    return chosen;
+}
+
+// Maximum number of surgeries across k identical rooms. Requests are taken by earliest end;
+// each goes to the room that became free latest but still no later than its start (best
+// fit), keeping earlier-free rooms for requests that start sooner. This greedy is optimal
+// for identical rooms. Room free times live in a balanced tree, so O(n log k).
+vector<Interval> schedule_k_rooms(vector<Interval> intervals, int k) {
+    sort(intervals.begin(), intervals.end(), [](const Interval &a, const Interval &b) {
+        if (a.end != b.end) return a.end < b.end;
+        return a.start < b.start;
+    });
+    multiset<pair<time_t,int>> free_at; // (time the room becomes free, room)
+    for (int r = 0; r < k; ++r) free_at.insert({numeric_limits<time_t>::min(), r});
+    vector<Interval> chosen;
+    for (auto &iv : intervals) {
+        auto it = free_at.upper_bound({iv.start, numeric_limits<int>::max()});
+        if (it == free_at.begin()) continue; // every room is busy at iv.start
+        --it;
+        iv.room = it->second;
+        free_at.erase(it);
+        free_at.insert({iv.end, iv.room});
+        chosen.push_back(iv);
+    }
+    return chosen;
+}
+
+// Interval partitioning: every request gets a room, using as few rooms as possible.
+// Requests are taken by start time and reuse the room that frees up earliest (min-heap)
+// when it is free by then; the room count reached equals the peak overlap, which is optimal.
+vector<Interval> partition_into_rooms(vector<Interval> intervals, int &rooms_used) {
+    sort(intervals.begin(), intervals.end(), [](const Interval &a, const Interval &b) {
+        if (a.start != b.start) return a.start < b.start;
+        return a.end < b.end;
+    });
+    priority_queue<pair<time_t,int>, vector<pair<time_t,int>>, greater<pair<time_t,int>>> busy_until;
+    rooms_used = 0;
+    for (auto &iv : intervals) {
+        if (!busy_until.empty() && busy_until.top().first <= iv.start) {
+            iv.room = busy_until.top().second;
+            busy_until.pop();
+        } else {
+            iv.room = rooms_used++;
+        }
+        busy_until.push({iv.end, iv.room});
+    }
+    return intervals;
+}
+
 // ----------------------------- Utilities ----------------------------------
 
 string time_t_to_iso(time_t t) {
@@ -232,38 +330,243 @@ string time_t_to_iso(time_t t) {
     return string(buf);
 }
 
+// --------------------------- Booking service ------------------------------
+
+// Booked slots of one OR, start -> (end, request id). Slots in a room never overlap, so
+// sorted by start they are sorted by end too: the only slot that can reach past a given
+// time s among those starting before e is the last one, and the clashes with [s, e) are
+// a contiguous run ending there. Checks are O(log n), listing is O(log n + clashes).
+struct RoomBook {
+    map<time_t, pair<time_t,string>> slots;
+
+    bool is_free(time_t s, time_t e) const {
+        auto it = slots.lower_bound(e);
+        if (it == slots.begin()) return true;
+        return prev(it)->second.first <= s;
+    }
+
+    // End of the last booking finishing by s (for best fit), or min if none
+    time_t free_since(time_t s) const {
+        auto it = slots.upper_bound(s);
+        if (it == slots.begin()) return numeric_limits<time_t>::min();
+        return prev(it)->second.first;
+    }
+
+    vector<pair<time_t,const pair<time_t,string>*>> conflicts(time_t s, time_t e) const {
+        vector<pair<time_t,const pair<time_t,string>*>> out;
+        for (auto it = slots.lower_bound(e); it != slots.begin();) {
+            --it;
+            if (it->second.first <= s) break;
+            out.push_back({it->first, &it->second});
+        }
+        reverse(out.begin(), out.end());
+        return out;
+    }
+};
+
+struct BookingService {
+    vector<RoomBook> rooms;
+    unordered_map<string, pair<int,time_t>> booked; // request id -> (room, start)
+
+    explicit BookingService(int room_count) : rooms(max(1, room_count)) {}
+
+    bool book(const string &id, time_t s, time_t e, int room) {
+        if (booked.count(id) || !rooms[room].is_free(s, e)) return false;
+        rooms[room].slots[s] = {e, id};
+        booked[id] = {room, s};
+        return true;
+    }
+
+    // Free rooms for [s, e); with room >= 0 only that room is considered
+    vector<int> free_rooms(time_t s, time_t e, int room) const {
+        vector<int> out;
+        for (int r = 0; r < (int)rooms.size(); ++r)
+            if ((room < 0 || r == room) && rooms[r].is_free(s, e)) out.push_back(r);
+        return out;
+    }
+
+    // Best fit among free rooms: the one whose previous booking ends closest before s
+    int pick_room(const vector<int> &free, time_t s) const {
+        int best = -1;
+        time_t best_since = 0;
+        for (int r : free) {
+            time_t since = rooms[r].free_since(s);
+            if (best == -1 || since > best_since) { best = r; best_since = since; }
+        }
+        return best;
+    }
+
+    string describe_conflicts(time_t s, time_t e, int room) const {
+        string out;
+        for (int r = 0; r < (int)rooms.size(); ++r) {
+            if (room >= 0 && r != room) continue;
+            for (auto &c : rooms[r].conflicts(s, e))
+                out += " " + c.second->second + "@OR" + to_string(r + 1) + "[" + time_t_to_iso(c.first) + " - " +
+                       time_t_to_iso(c.second->first) + "]";
+        }
+        return out;
+    }
+
+    bool cancel(const string &id) {
+        auto it = booked.find(id);
+        if (it == booked.end()) return false;
+        rooms[it->second.first].slots.erase(it->second.second);
+        booked.erase(it);
+        return true;
+    }
+};
+
+// Front-desk protocol on stdin, one command per line (times as in the CSV):
+//   CAN_BOOK start,end[,room]     -> YES OR.. OR.. | NO conflicts: id@ORn[start - end] ...
+//   BOOK id,start,end[,room]      -> BOOKED id ORn | REJECTED id conflicts: ... | REJECTED id duplicate
+//   CANCEL id                     -> CANCELLED id | NOT_FOUND id
+//   QUIT
+// Rooms are written OR1..ORk or 1..k; without one, BOOK best-fits into any free room.
+void run_booking_service(BookingService &svc) {
+    auto parse_room = [&](const string &s, int &room) {
+        string t = s;
+        if (t.size() > 2 && toupper((unsigned char)t[0]) == 'O' && toupper((unsigned char)t[1]) == 'R') t = t.substr(2);
+        try { room = stoi(t) - 1; } catch (...) { return false; }
+        return room >= 0 && room < (int)svc.rooms.size();
+    };
+    size_t commands = 0;
+    auto t0 = chrono::steady_clock::now();
+    string line;
+    while (getline(cin, line)) {
+        size_t sp = line.find(' ');
+        string cmd = line.substr(0, sp);
+        for (auto &c : cmd) c = (char)toupper((unsigned char)c);
+        vector<string> args;
+        if (sp != string::npos) parse_csv_line(line.substr(sp + 1), args);
+        if (cmd.empty() || cmd[0] == '#') continue;
+        if (cmd == "QUIT" || cmd == "EXIT") break;
+        ++commands;
+        if (cmd == "CANCEL" && args.size() == 1) {
+            cout << (svc.cancel(args[0]) ? "CANCELLED " : "NOT_FOUND ") << args[0] << "\n";
+            continue;
+        }
+        bool booking = cmd == "BOOK";
+        size_t first = booking ? 1 : 0;
+        time_t s, e;
+        int room = -1;
+        if ((cmd != "CAN_BOOK" && !booking) || args.size() < first + 2 || args.size() > first + 3 ||
+            !parse_iso_datetime(args[first], s) || !parse_iso_datetime(args[first + 1], e) || e <= s ||
+            (args.size() == first + 3 && !parse_room(args[first + 2], room))) {
+            cout << "ERROR bad command: " << line << "\n";
+            continue;
+        }
+        vector<int> free = svc.free_rooms(s, e, room);
+        if (!booking) {
+            if (free.empty()) cout << "NO conflicts:" << svc.describe_conflicts(s, e, room) << "\n";
+            else {
+                cout << "YES";
+                for (int r : free) cout << " OR" << r + 1;
+                cout << "\n";
+            }
+            continue;
+        }
+        const string &id = args[0];
+        if (svc.booked.count(id)) cout << "REJECTED " << id << " duplicate\n";
+        else if (free.empty()) cout << "REJECTED " << id << " conflicts:" << svc.describe_conflicts(s, e, room) << "\n";
+        else {
+            int r = svc.pick_room(free, s);
+            svc.book(id, s, e, r);
+            cout << "BOOKED " << id << " OR" << r + 1 << "\n";
+        }
+    }
+    double ms = chrono::duration<double, milli>(chrono::steady_clock::now() - t0).count();
+    cerr << "Handled " << commands << " commands in " << ms << " ms (" << (ms > 0 ? commands / ms * 1000.0 : 0.0)
+         << " commands/s); " << svc.booked.size() << " bookings held.\n";
+}
+
+// Random requests over 30 days from 2025-12-15 00:00: start on any minute, 30-300 minute
+// durations, integer weight 1-10. Used by --synthetic for benchmarking.
+vector<Interval> generate_requests(size_t n, unsigned seed) {
+    time_t base;
+    parse_iso_datetime("2025-12-15 00:00", base);
+    mt19937_64 rng(seed);
+    vector<Interval> out(n);
+    for (size_t i = 0; i < n; ++i) {
+        Interval &iv = out[i];
+        iv.id = "SYN" + to_string(i + 1);
+        iv.start = base + (time_t)(rng() % (30 * 24 * 60)) * 60;
+        iv.duration_minutes = 30 + (int)(rng() % 271);
+        iv.end = iv.start + (time_t)iv.duration_minutes * 60;
+        iv.weight = (double)(1 + rng() % 10);
+    }
+    return out;
+}
+
 // ----------------------------- Main ---------------------------------------
 
 int main(int argc, char** argv) {
     ios::sync_with_stdio(false);
     cin.tie(nullptr);
     if (argc < 2) {
-        cerr << "Usage: " << argv[0] << " surgeries.csv [--min-duration M] [--max-duration M] [--output out.csv] [--verbose]\n";
+        cerr << "Usage: " << argv[0] << " surgeries.csv [--min-duration M] [--max-duration M] [--rooms K | --partition | --weighted] [--output out.csv] [--verbose]\n";
+        cerr << "       " << argv[0] << " --synthetic N [options]\n";
+        cerr << "  --rooms K     maximize surgeries across K identical operating rooms\n";
+        cerr << "  --partition   assign every request, using the minimum number of rooms\n";
+        cerr << "  --weighted    maximize total weight (weight/priority column) in one room\n";
+        cerr << "  --synthetic N use N random requests instead of a CSV and report timings\n";
+        cerr << "  --serve       then answer CAN_BOOK/BOOK/CANCEL commands on stdin against the schedule\n";
+        cerr << "                (without a CSV: start from empty rooms, --rooms K of them)\n";
         return 1;
     }
-    string infile = argv[1];
+    string infile = argv[1][0] == '-' ? "" : argv[1];
     int min_dur = 0, max_dur = 1000000;
     string outfile = "scheduled_surgeries.csv";
     bool verbose = false;
-    for (int i=2;i<argc;++i) {
+    int rooms = 1;
+    bool partition = false;
+    bool weighted = false;
+    size_t synthetic = 0;
+    bool serve = false;
+    for (int i=infile.empty() ? 1 : 2;i<argc;++i) {
         string s = argv[i];
         if (s == "--min-duration" && i+1<argc) { min_dur = stoi(argv[++i]); }
         else if (s == "--max-duration" && i+1<argc) { max_dur = stoi(argv[++i]); }
         else if (s == "--output" && i+1<argc) { outfile = argv[++i]; }
         else if (s == "--verbose") verbose = true;
+        else if (s == "--rooms" && i+1<argc) { rooms = max(1, stoi(argv[++i])); }
+        else if (s == "--partition") partition = true;
+        else if (s == "--weighted") weighted = true;
+        else if (s == "--synthetic" && i+1<argc) { synthetic = stoul(argv[++i]); }
+        else if (s == "--serve") serve = true;
     }
 
-    vector<Interval> intervals;
-    string err;
-    if (!load_intervals_from_csv(infile, intervals, err)) {
-        cerr << "Error loading CSV: " << err << "\n";
-        return 1;
+    if (weighted && (partition || rooms > 1)) {
+        cerr << "--weighted schedules a single room; ignoring --rooms/--partition.\n";
+        partition = false;
+        rooms = 1;
     }
-    if (intervals.empty()) {
-        cerr << "No valid intervals loaded.\n";
-        return 1;
+
+    if (serve && synthetic == 0 && infile.empty()) {
+        BookingService svc(rooms);
+        cout << "Booking service ready with " << svc.rooms.size() << " empty operating rooms.\n";
+        run_booking_service(svc);
+        return 0;
+    }
+
+    vector<Interval> intervals;
+    if (synthetic > 0) {
+        auto g0 = chrono::steady_clock::now();
+        intervals = generate_requests(synthetic, 42);
+        double gms = chrono::duration<double, milli>(chrono::steady_clock::now() - g0).count();
+        cout << "Generated " << intervals.size() << " synthetic surgery requests in " << gms << " ms\n";
+    } else {
+        if (infile.empty()) { cerr << "No input CSV given.\n"; return 1; }
+        string err;
+        if (!load_intervals_from_csv(infile, intervals, err)) {
+            cerr << "Error loading CSV: " << err << "\n";
+            return 1;
+        }
+        if (intervals.empty()) {
+            cerr << "No valid intervals loaded.\n";
+            return 1;
+        }
+        cout << "Loaded " << intervals.size() << " surgery requests from " << infile << "\n";
     }
-    cout << "Loaded " << intervals.size() << " surgery requests from " << infile << "\n";
 
     // apply duration filters
     vector<Interval> filtered;
@@ -276,11 +579,30 @@ int main(int argc, char** argv) {
     cout << "After duration filter: " << filtered.size() << " intervals remain.\n";
 
     // Run greedy scheduling
-    auto scheduled = schedule_max_nonoverlapping(filtered);
-    cout << "Scheduled " << scheduled.size() << " surgeries (maximum by greedy algorithm).\n";
+    bool multi_room = partition || rooms > 1;
+    vector<Interval> scheduled;
+    auto t0 = chrono::steady_clock::now();
+    double total_weight = 0.0;
+    int room_count = rooms;
+    if (weighted) {
+        scheduled = schedule_max_weight(filtered, total_weight);
+        cout << "Scheduled " << scheduled.size() << " surgeries with maximum total weight " << total_weight << ".\n";
+    } else if (partition) {
+        scheduled = partition_into_rooms(filtered, room_count);
+        cout << "All " << scheduled.size() << " surgeries fit in " << room_count << " operating rooms (minimum).\n";
+    } else if (rooms > 1) {
+        scheduled = schedule_k_rooms(filtered, rooms);
+        cout << "Scheduled " << scheduled.size() << " surgeries across " << rooms << " operating rooms (maximum by greedy algorithm).\n";
+    } else {
+        scheduled = schedule_max_nonoverlapping(filtered);
+        cout << "Scheduled " << scheduled.size() << " surgeries (maximum by greedy algorithm).\n";
+    }
+    double ms = chrono::duration<double, milli>(chrono::steady_clock::now() - t0).count();
+    if (verbose || synthetic > 0) cout << "Scheduling took " << ms << " ms.\n";
 
-    // Sort scheduled by start time for human-friendly output
+    // Sort scheduled by (room,) start time for human-friendly output
     sort(scheduled.begin(), scheduled.end(), [](const Interval &a, const Interval &b) {
+        if (a.room != b.room) return a.room < b.room;
         if (a.start != b.start) return a.start < b.start;
         return a.end < b.end;
     });
@@ -291,9 +613,13 @@ int main(int argc, char** argv) {
         cerr << "Failed to open output file: " << outfile << "\n";
         return 1;
     }
-    fout << "request_id,start,end,duration_minutes\n";
+    fout << "request_id," << (multi_room ? "room," : "") << "start,end,duration_minutes" << (weighted ? ",weight" : "") << "\n";
     for (auto &iv : scheduled) {
-        fout << iv.id << "," << time_t_to_iso(iv.start) << "," << time_t_to_iso(iv.end) << "," << iv.duration_minutes << "\n";
+        fout << iv.id << ",";
+        if (multi_room) fout << "OR" << iv.room + 1 << ",";
+        fout << time_t_to_iso(iv.start) << "," << time_t_to_iso(iv.end) << "," << iv.duration_minutes;
+        if (weighted) fout << "," << iv.weight;
+        fout << "\n";
     }
     fout.close();
     cout << "Wrote scheduled surgeries to " << outfile << "\n";
@@ -301,7 +627,9 @@ int main(int argc, char** argv) {
     if (verbose) {
         cout << "Full scheduled list:\n";
         for (auto &iv : scheduled) {
-            cout << iv.id << " | " << time_t_to_iso(iv.start) << " -> " << time_t_to_iso(iv.end) << " | " << iv.duration_minutes << "min\n";
+            cout << iv.id << " | ";
+            if (multi_room) cout << "OR" << iv.room + 1 << " | ";
+            cout << time_t_to_iso(iv.start) << " -> " << time_t_to_iso(iv.end) << " | " << iv.duration_minutes << "min\n";
         }
     }
 
@@ -310,11 +638,24 @@ int main(int argc, char** argv) {
         time_t first_start = scheduled.front().start;
         time_t last_end = scheduled.back().end;
         double total_scheduled_minutes = 0.0;
-        for (auto &iv : scheduled) total_scheduled_minutes += iv.duration_minutes;
+        for (auto &iv : scheduled) {
+            first_start = min(first_start, iv.start);
+            last_end = max(last_end, iv.end);
+            total_scheduled_minutes += iv.duration_minutes;
+        }
         cout << fixed << setprecision(1);
         cout << "First scheduled start: " << time_t_to_iso(first_start) << "\n";
         cout << "Last scheduled end:   " << time_t_to_iso(last_end) << "\n";
         cout << "Total scheduled surgery time: " << total_scheduled_minutes << " minutes (~" << (total_scheduled_minutes/60.0) << " hours)\n";
+        cout.unsetf(ios::fixed);
+    }
+
+    if (serve) {
+        BookingService svc(room_count);
+        for (auto &iv : scheduled) svc.book(iv.id, iv.start, iv.end, iv.room);
+        cout << "Booking service ready: " << svc.booked.size() << " scheduled surgeries in " << svc.rooms.size()
+             << " operating rooms.\n";
+        run_booking_service(svc);
     }
 
     return 0;
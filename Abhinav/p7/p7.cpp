@@ -3,15 +3,26 @@
 //
 // Compile: g++ -std=c++17 -O2 -pthread -o ring_buffer_calls ring_buffer_calls.cpp
 //
-// Usage: ./ring_buffer_calls calls.csv [K=100] [--output audit_last_k.csv]
+// Usage: ./ring_buffer_calls calls.csv [K=100] [--output audit_last_k.csv] [--lockfree | --mmap ring.bin]
+//        ./ring_buffer_calls calls.csv [K=100] --bench [--threads MAX=32] [--ops N=2000000]
+//        ./ring_buffer_calls calls.csv [K=100] --range "2025-12-01 10:02" "2025-12-01 10:07" [--caller NUMBER]
+//        ./ring_buffer_calls --audit-bench 10000000 [--queries 1000]
 //
 // The program reads a CSV of call logs (call_id,caller,callee,timestamp,duration_seconds,status),
 // streams them into a fixed-size ring buffer of capacity K, and writes the final buffer
-// contents (oldest->newest) to an output CSV.
+// contents (oldest->newest) to an output CSV. --lockfree ingests through the lock-free
+// ring instead of the mutex one; --mmap appends packed records to a memory-mapped ring
+// file that keeps the last K calls across runs. --bench measures push throughput of the
+// rings under 1..MAX producer threads with a concurrent auditor. --range answers an
+// audit time-window query (optionally for one caller) over the last K calls.
 
 #include <bits/stdc++.h>
 #include <atomic>
 #include <shared_mutex>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
 using namespace std;
 
 // --------------------------- Call record ----------------------------------
@@ -42,6 +53,142 @@ struct CallRecord {
     }
 };
 
+// ------------------------ Packed call record ------------------------------
+//
+// Fixed-width, trivially copyable encoding of CallRecord: 48 bytes, no heap.
+// Phone numbers are stored as their digits in a uint64 (E.164 has at most 15)
+// plus the digit count, so leading zeros and the '+' prefix round-trip.
+
+enum class CallStatus : uint8_t { Unknown = 0, Connected, Missed, Busy, Voicemail, Failed };
+
+static const char *CALL_STATUS_NAMES[] = {"", "connected", "missed", "busy", "voicemail", "failed"};
+
+struct PackedCall {
+    int64_t timestamp;          // seconds since epoch, UTC
+    uint64_t caller;            // phone digits
+    uint64_t callee;
+    uint32_t duration_seconds;
+    uint8_t caller_digits;      // low 7 bits = digit count, high bit = had '+'
+    uint8_t callee_digits;
+    CallStatus status;
+    uint8_t flags;              // PACKED_VALID on every encoded record
+    char call_id[16];           // NUL-padded
+};
+static_assert(sizeof(PackedCall) == 48, "PackedCall layout changed");
+static_assert(is_trivially_copyable<PackedCall>::value, "PackedCall must be POD");
+
+constexpr uint8_t PHONE_PLUS = 0x80;
+constexpr uint8_t PACKED_VALID = 0x01;
+
+bool pack_phone(const string &s, uint64_t &value, uint8_t &digits) {
+    value = 0;
+    digits = 0;
+    size_t i = 0;
+    if (!s.empty() && s[0] == '+') { digits = PHONE_PLUS; i = 1; }
+    if (i == s.size() || s.size() - i > 15) return false;
+    for (; i < s.size(); ++i) {
+        if (!isdigit((unsigned char)s[i])) return false;
+        value = value * 10 + (uint64_t)(s[i] - '0');
+        ++digits;
+    }
+    return true;
+}
+
+// One integer per distinct number (value < 10^15 leaves the top byte free)
+inline uint64_t phone_key(uint64_t value, uint8_t digits) { return value | ((uint64_t)digits << 56); }
+
+string unpack_phone(uint64_t value, uint8_t digits) {
+    int n = digits & ~PHONE_PLUS;
+    string out(n, '0');
+    for (int i = n - 1; i >= 0; --i, value /= 10) out[i] = char('0' + value % 10);
+    return (digits & PHONE_PLUS) ? "+" + out : out;
+}
+
+// "YYYY-MM-DD HH:MM[:SS]" (or with 'T') as UTC epoch seconds
+bool parse_call_timestamp(const string &s, int64_t &out) {
+    struct tm tm_time = {};
+    char sep = 0;
+    if (sscanf(s.c_str(), "%d-%d-%d%c%d:%d:%d", &tm_time.tm_year, &tm_time.tm_mon, &tm_time.tm_mday,
+               &sep, &tm_time.tm_hour, &tm_time.tm_min, &tm_time.tm_sec) < 6) return false;
+    if (sep != ' ' && sep != 'T') return false;
+    tm_time.tm_year -= 1900;
+    tm_time.tm_mon -= 1;
+    out = (int64_t)timegm(&tm_time);
+    return true;
+}
+
+string format_call_timestamp(int64_t ts) {
+    time_t t = (time_t)ts;
+    struct tm tm_time;
+    gmtime_r(&t, &tm_time);
+    char buf[32];
+    strftime(buf, sizeof(buf), "%Y-%m-%d %H:%M:%S", &tm_time);
+    return buf;
+}
+
+CallStatus parse_call_status(const string &s) {
+    string k = s;
+    for (char &ch : k) ch = (char)tolower((unsigned char)ch);
+    for (int i = 1; i < (int)(sizeof(CALL_STATUS_NAMES) / sizeof(CALL_STATUS_NAMES[0])); ++i)
+        if (k == CALL_STATUS_NAMES[i]) return (CallStatus)i;
+    return CallStatus::Unknown;
+}
+
+// Encode a parsed CSV record; fails on values that do not fit the fixed layout.
+bool pack_call(const CallRecord &rec, PackedCall &out, string &err) {
+    memset(&out, 0, sizeof(out));
+    if (rec.call_id.size() > sizeof(out.call_id)) { err = "call_id too long: " + rec.call_id; return false; }
+    memcpy(out.call_id, rec.call_id.data(), rec.call_id.size());
+    if (!pack_phone(rec.caller, out.caller, out.caller_digits)) { err = "bad caller number: " + rec.caller; return false; }
+    if (!pack_phone(rec.callee, out.callee, out.callee_digits)) { err = "bad callee number: " + rec.callee; return false; }
+    if (!parse_call_timestamp(rec.timestamp, out.timestamp)) { err = "bad timestamp: " + rec.timestamp; return false; }
+    out.duration_seconds = (uint32_t)max(0, rec.duration_seconds);
+    out.status = parse_call_status(rec.status);
+    if (out.status == CallStatus::Unknown && !rec.status.empty()) { err = "unknown status: " + rec.status; return false; }
+    out.flags = PACKED_VALID;
+    return true;
+}
+
+CallRecord unpack_call(const PackedCall &p) {
+    CallRecord rec;
+    rec.call_id.assign(p.call_id, strnlen(p.call_id, sizeof(p.call_id)));
+    rec.caller = unpack_phone(p.caller, p.caller_digits);
+    rec.callee = unpack_phone(p.callee, p.callee_digits);
+    rec.timestamp = format_call_timestamp(p.timestamp);
+    rec.duration_seconds = (int)p.duration_seconds;
+    rec.status = CALL_STATUS_NAMES[(int)p.status];
+    return rec;
+}
+
+// --------------------------- CSV writer -----------------------------------
+
+// Write rows (anything with to_csv_row) to CSV file (atomic write via temp file then rename)
+template<typename T>
+bool write_rows_csv(const string &filename, const vector<string> &header, const vector<T> &rows) {
+    string tmp = filename + ".tmp";
+    ofstream fout(tmp, ios::binary);
+    if (!fout.is_open()) return false;
+    // header
+    if (!header.empty()) {
+        for (size_t i = 0; i < header.size(); ++i) {
+            fout << header[i];
+            if (i+1 < header.size()) fout << ",";
+        }
+        fout << "\n";
+    }
+    for (auto &rec : rows) fout << rec.to_csv_row() << "\n";
+    fout.close();
+    // atomic rename
+    std::error_code ec;
+    std::filesystem::rename(tmp, filename, ec);
+    if (ec) {
+        // fallback: try remove and rename
+        std::remove(filename.c_str());
+        std::rename(tmp.c_str(), filename.c_str());
+    }
+    return true;
+}
+
 // --------------------------- Ring buffer ----------------------------------
 
 template<typename T>
@@ -65,7 +212,7 @@ public:
     // Return number of items currently in buffer
     size_t size() const {
         shared_lock<shared_mutex> lock(mutex_);
-        return full_ ? capacity_ : next_index_;
+        return size_unlocked();
     }
 
     // Return buffer capacity
@@ -83,7 +230,7 @@ public:
     vector<T> get_all() const {
         shared_lock<shared_mutex> lock(mutex_);
         vector<T> out;
-        size_t sz = size();
+        size_t sz = size_unlocked();
         out.reserve(sz);
         if (sz == 0) return out;
         size_t start = full_ ? next_index_ : 0;
@@ -97,7 +244,7 @@ public:
     // Random access: index 0 = oldest, index size()-1 = newest. Throws if out of range.
     T get_at_oldest_index(size_t idx) const {
         shared_lock<shared_mutex> lock(mutex_);
-        size_t sz = size();
+        size_t sz = size_unlocked();
         if (idx >= sz) throw out_of_range("index out of range");
         size_t start = full_ ? next_index_ : 0;
         size_t real_idx = (start + idx) % capacity_;
@@ -106,32 +253,14 @@ public:
 
     // Write buffer contents to CSV file (atomic write via temp file then rename)
     bool serialize_to_csv(const string &filename, const vector<string> &header = {}) const {
-        string tmp = filename + ".tmp";
-        ofstream fout(tmp, ios::binary);
-        if (!fout.is_open()) return false;
-        // header
-        if (!header.empty()) {
-            for (size_t i = 0; i < header.size(); ++i) {
-                fout << header[i];
-                if (i+1 < header.size()) fout << ",";
-            }
-            fout << "\n";
-        }
-        auto all = get_all();
-        for (auto &rec : all) fout << rec.to_csv_row() << "\n";
-        fout.close();
-        // atomic rename
-        std::error_code ec;
-        std::filesystem::rename(tmp, filename, ec);
-        if (ec) {
-            // fallback: try remove and rename
-            std::remove(filename.c_str());
-            std::rename(tmp.c_str(), filename.c_str());
-        }
-        return true;
+        return write_rows_csv(filename, header, get_all());
     }
 
 private:
+    // Callers must already hold mutex_ (shared or unique); re-locking a
+    // shared_mutex from the same thread is undefined behaviour.
+    size_t size_unlocked() const { return full_ ? capacity_ : next_index_; }
+
     size_t capacity_;
     mutable shared_mutex mutex_;
     vector<T> buffer_;
@@ -139,6 +268,395 @@ private:
     bool full_;
 };
 
+// ----------------------- Lock-free ring buffer ----------------------------
+//
+// Same "keep the last K" semantics as RingBuffer, without a global lock.
+// Producers claim a ticket with one fetch_add on head_; ticket t owns slot
+// t % K. Every slot carries a sequence word recording which ticket it holds
+// and in what state, so a producer only ever waits on the producer one lap
+// behind it (or a reader copying that old record), never on unrelated slots.
+// head_ and each slot sit on their own cache line so producers hammering
+// head_ and writing neighbouring slots do not false-share.
+
+constexpr size_t CACHE_LINE = 64;
+
+// Spin briefly, then yield, then sleep: the thread we wait on may have
+// been preempted mid-copy when producers outnumber cores.
+inline void ring_backoff(int spins) {
+    if (spins < 64) return;
+    if (spins < 128) this_thread::yield();
+    else this_thread::sleep_for(chrono::microseconds(20));
+}
+
+template<typename T>
+class LockFreeRing {
+public:
+    explicit LockFreeRing(size_t capacity)
+        : capacity_(capacity), slots_(capacity)
+    {
+        if (capacity_ == 0) throw invalid_argument("capacity must be > 0");
+    }
+
+    // Push an item; overwrites oldest when full. Safe for any number of producers.
+    void push(const T &item) {
+        uint64_t t = head_.fetch_add(1, memory_order_relaxed);
+        Slot &s = slots_[t % capacity_];
+        // Wait until the previous lap's record in this slot is published and
+        // nobody is copying it, then take it over.
+        uint64_t prev = t >= capacity_ ? stamp(t - capacity_, PUBLISHED) : 0;
+        for (int spins = 0;; ++spins) {
+            uint64_t cur = prev;
+            if (s.seq.compare_exchange_weak(cur, stamp(t, WRITING), memory_order_acquire, memory_order_relaxed)) break;
+            ring_backoff(spins);
+        }
+        s.value = item;
+        s.seq.store(stamp(t, PUBLISHED), memory_order_release);
+    }
+
+    // Number of records claimed so far, capped at capacity (may include in-flight pushes)
+    size_t size() const { return (size_t)min<uint64_t>(head_.load(memory_order_acquire), capacity_); }
+
+    size_t capacity() const { return capacity_; }
+
+    // Total pushes ever claimed
+    uint64_t pushed() const { return head_.load(memory_order_acquire); }
+
+    // Consistent oldest->newest snapshot taken while producers keep running.
+    // Records are returned in ticket order with no gaps: records overwritten
+    // while we walk are dropped from the front (they are older than anything
+    // we still return), and the walk stops at the first ticket whose producer
+    // has not finished writing. Each slot is pinned only while it is copied.
+    vector<T> snapshot() const {
+        vector<T> out;
+        uint64_t hi = head_.load(memory_order_acquire);
+        uint64_t lo = hi > capacity_ ? hi - capacity_ : 0;
+        out.reserve(hi - lo);
+        for (uint64_t t = lo; t < hi; ++t) {
+            Slot &s = slots_[t % capacity_];
+            uint64_t want = stamp(t, PUBLISHED);
+            bool copied = false;
+            for (int spins = 0;; ++spins) {
+                uint64_t cur = want;
+                if (s.seq.compare_exchange_weak(cur, stamp(t, READING), memory_order_acquire, memory_order_relaxed)) {
+                    out.push_back(s.value);
+                    s.seq.store(want, memory_order_release);
+                    copied = true;
+                    break;
+                }
+                if (cur >= stamp(t + 1, WRITING)) break;           // overwritten by a later lap
+                if (cur < want) return out;                         // ticket t still being written
+                ring_backoff(spins);                                // another reader holds it
+            }
+            if (!copied && !out.empty()) {
+                // A hole after records we already copied would break ordering;
+                // anything older than the hole is stale now, so restart from it.
+                out.clear();
+            }
+        }
+        return out;
+    }
+
+    bool serialize_to_csv(const string &filename, const vector<string> &header = {}) const {
+        return write_rows_csv(filename, header, snapshot());
+    }
+
+private:
+    enum : uint64_t { WRITING = 0, PUBLISHED = 1, READING = 2 };
+    // 0 means "never written"; ticket t maps to 4(t+1) + state.
+    static uint64_t stamp(uint64_t t, uint64_t state) { return (t + 1) * 4 + state; }
+
+    struct alignas(CACHE_LINE) Slot {
+        atomic<uint64_t> seq{0};
+        T value{};
+    };
+
+    size_t capacity_;
+    alignas(CACHE_LINE) atomic<uint64_t> head_{0};
+    char pad_[CACHE_LINE - sizeof(atomic<uint64_t>)];
+    mutable vector<Slot> slots_;
+};
+
+// ---------------------- Persistent mmap call ring -------------------------
+//
+// The last K PackedCalls live in a memory-mapped file, so the audit trail
+// survives restarts and persisting is the kernel's job (sync() forces it)
+// instead of a CSV rewrite. Layout: one 64-byte header, then K 64-byte
+// slots. Producers use the same ticket/slot-sequence scheme as LockFreeRing
+// with head in the file header. Because the payload is POD, readers never
+// pin a slot: they copy it and re-check the sequence (seqlock style), so
+// audits never hold up producers.
+
+static const char CALL_RING_MAGIC[8] = {'C','A','L','L','R','N','G','1'};
+
+struct alignas(CACHE_LINE) CallRingHeader {
+    char magic[8];
+    uint64_t capacity;
+    uint64_t record_size;
+    atomic<uint64_t> head;      // tickets claimed so far
+};
+
+struct alignas(CACHE_LINE) CallRingSlot {
+    atomic<uint64_t> seq;       // same stamp encoding as LockFreeRing
+    atomic<uint64_t> words[sizeof(PackedCall) / 8];
+};
+static_assert(sizeof(CallRingHeader) == CACHE_LINE && sizeof(CallRingSlot) == CACHE_LINE, "ring file layout changed");
+static_assert(atomic<uint64_t>::is_always_lock_free, "mapped atomics must be lock-free");
+
+class MappedCallRing {
+public:
+    MappedCallRing() = default;
+    MappedCallRing(const MappedCallRing&) = delete;
+    MappedCallRing& operator=(const MappedCallRing&) = delete;
+    ~MappedCallRing() { if (map_) munmap(map_, map_size_); }
+
+    // Open an existing ring file, or create one with `capacity` slots. An
+    // existing file keeps its own capacity. Slots left half-written by a
+    // crash are cleared so readers skip them; `recovered` counts them.
+    bool open(const string &filename, size_t capacity, string &err) {
+        int fd = ::open(filename.c_str(), O_RDWR | O_CREAT, 0644);
+        if (fd < 0) { err = "Cannot open ring file: " + filename; return false; }
+        struct stat st;
+        if (fstat(fd, &st) != 0) { ::close(fd); err = "Cannot stat ring file: " + filename; return false; }
+        bool fresh = st.st_size == 0;
+        if (fresh) {
+            if (capacity == 0) { ::close(fd); err = "capacity must be > 0"; return false; }
+            map_size_ = sizeof(CallRingHeader) + capacity * sizeof(CallRingSlot);
+            if (ftruncate(fd, (off_t)map_size_) != 0) { ::close(fd); err = "Cannot size ring file: " + filename; return false; }
+        } else {
+            map_size_ = (size_t)st.st_size;
+            if (map_size_ < sizeof(CallRingHeader)) { ::close(fd); err = "Not a call ring file: " + filename; return false; }
+        }
+        map_ = mmap(nullptr, map_size_, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+        ::close(fd);
+        if (map_ == MAP_FAILED) { map_ = nullptr; err = "mmap failed: " + filename; return false; }
+        header_ = static_cast<CallRingHeader*>(map_);
+        slots_ = reinterpret_cast<CallRingSlot*>(static_cast<char*>(map_) + sizeof(CallRingHeader));
+        if (fresh) {
+            // ftruncate zero-filled the file: every slot reads as "never written"
+            memcpy(header_->magic, CALL_RING_MAGIC, 8);
+            header_->capacity = capacity;
+            header_->record_size = sizeof(PackedCall);
+        } else if (memcmp(header_->magic, CALL_RING_MAGIC, 8) != 0 || header_->record_size != sizeof(PackedCall) ||
+                   header_->capacity == 0 ||
+                   map_size_ < sizeof(CallRingHeader) + header_->capacity * sizeof(CallRingSlot)) {
+            err = "Not a call ring file: " + filename;
+            return false;
+        }
+        capacity_ = header_->capacity;
+        recovered_ = fresh ? 0 : recover();
+        return true;
+    }
+
+    void push(const PackedCall &rec) {
+        uint64_t t = header_->head.fetch_add(1, memory_order_relaxed);
+        CallRingSlot &s = slots_[t % capacity_];
+        uint64_t prev = t >= capacity_ ? stamp(t - capacity_, PUBLISHED) : 0;
+        for (int spins = 0;; ++spins) {
+            uint64_t cur = prev;
+            if (s.seq.compare_exchange_weak(cur, stamp(t, WRITING), memory_order_acquire, memory_order_relaxed)) break;
+            ring_backoff(spins);
+        }
+        atomic_thread_fence(memory_order_release);
+        uint64_t w[sizeof(PackedCall) / 8];
+        memcpy(w, &rec, sizeof(rec));
+        for (size_t i = 0; i < sizeof(PackedCall) / 8; ++i) s.words[i].store(w[i], memory_order_relaxed);
+        s.seq.store(stamp(t, PUBLISHED), memory_order_release);
+    }
+
+    // Oldest->newest, ticket-ordered, gap-free; same rules as LockFreeRing::snapshot.
+    vector<PackedCall> snapshot() const {
+        vector<PackedCall> out;
+        uint64_t hi = header_->head.load(memory_order_acquire);
+        uint64_t lo = hi > capacity_ ? hi - capacity_ : 0;
+        out.reserve(hi - lo);
+        PackedCall rec;
+        for (uint64_t t = lo; t < hi; ++t) {
+            SlotRead r = read_slot(t, rec);
+            if (r == IN_FLIGHT) break;
+            if (r == OVERWRITTEN) { out.clear(); continue; }
+            if (r == COPIED) out.push_back(rec);      // CLEARED: lost in a crash, skip
+        }
+        return out;
+    }
+
+    // Force dirty pages to disk (restart-safety needs nothing; this is for power loss)
+    bool sync() const { return msync(map_, map_size_, MS_SYNC) == 0; }
+
+    size_t capacity() const { return capacity_; }
+    uint64_t pushed() const { return header_->head.load(memory_order_acquire); }
+    size_t size() const { return (size_t)min<uint64_t>(pushed(), capacity_); }
+    size_t recovered() const { return recovered_; }
+
+private:
+    enum : uint64_t { WRITING = 0, PUBLISHED = 1 };
+    static uint64_t stamp(uint64_t t, uint64_t state) { return (t + 1) * 4 + state; }
+
+    enum SlotRead { IN_FLIGHT, OVERWRITTEN, CLEARED, COPIED };
+
+    SlotRead read_slot(uint64_t t, PackedCall &rec) const {
+        const CallRingSlot &s = slots_[t % capacity_];
+        uint64_t want = stamp(t, PUBLISHED);
+        for (;;) {
+            uint64_t before = s.seq.load(memory_order_acquire);
+            if (before > want) return OVERWRITTEN;
+            if (before != want) return IN_FLIGHT;
+            uint64_t w[sizeof(PackedCall) / 8];
+            for (size_t i = 0; i < sizeof(PackedCall) / 8; ++i) w[i] = s.words[i].load(memory_order_relaxed);
+            atomic_thread_fence(memory_order_acquire);
+            if (s.seq.load(memory_order_relaxed) != before) continue;   // raced with a producer; re-check
+            memcpy(&rec, w, sizeof(rec));
+            return (rec.flags & PACKED_VALID) ? COPIED : CLEARED;
+        }
+    }
+
+    // After a crash, tickets in the last window may never have been published.
+    // Stamp them as published with a zeroed (flags == 0) record so producers
+    // can lap them and readers skip them.
+    size_t recover() {
+        uint64_t hi = header_->head.load();
+        uint64_t lo = hi > capacity_ ? hi - capacity_ : 0;
+        size_t fixed = 0;
+        for (uint64_t t = lo; t < hi; ++t) {
+            CallRingSlot &s = slots_[t % capacity_];
+            if (s.seq.load() == stamp(t, PUBLISHED)) continue;
+            for (auto &w : s.words) w.store(0);
+            s.seq.store(stamp(t, PUBLISHED));
+            ++fixed;
+        }
+        return fixed;
+    }
+
+    void *map_ = nullptr;
+    size_t map_size_ = 0;
+    CallRingHeader *header_ = nullptr;
+    CallRingSlot *slots_ = nullptr;
+    size_t capacity_ = 0;
+    size_t recovered_ = 0;
+};
+
+// ------------------------ Time-range audit queries ------------------------
+//
+// Single-writer ring of PackedCalls kept in one contiguous array so range
+// queries can hand back pointers into it. Calls arrive in timestamp order,
+// so the logical ring (oldest->newest) is sorted by timestamp and a range is
+// two binary searches over logical positions; the answer is at most two
+// physical spans because the window may wrap past the end of the array.
+// A per-caller list of tickets (push sequence numbers) answers "calls by X
+// between A and B" the same way without touching other callers' records.
+// Spans stay valid until the next push.
+
+struct CallSpan {
+    const PackedCall *data = nullptr;
+    size_t size = 0;
+    const PackedCall *begin() const { return data; }
+    const PackedCall *end() const { return data + size; }
+};
+
+class CallAuditRing {
+public:
+    explicit CallAuditRing(size_t capacity) : capacity_(capacity), buffer_(capacity)
+    {
+        if (capacity_ == 0) throw invalid_argument("capacity must be > 0");
+    }
+
+    void push(const PackedCall &rec) {
+        size_t slot = head_ % capacity_;
+        if (head_ >= capacity_) {
+            // Evict the oldest record; it is the front of its caller's deque.
+            const PackedCall &old = buffer_[slot];
+            auto it = by_caller_.find(phone_key(old.caller, old.caller_digits));
+            if (!it->second.pop_front()) by_caller_.erase(it);
+        }
+        if (head_ > 0 && rec.timestamp < last_timestamp_) last_unordered_ = head_;
+        last_timestamp_ = rec.timestamp;
+        buffer_[slot] = rec;
+        by_caller_[phone_key(rec.caller, rec.caller_digits)].tickets.push_back(head_);
+        ++head_;
+    }
+
+    size_t size() const { return (size_t)min<uint64_t>(head_, capacity_); }
+    size_t capacity() const { return capacity_; }
+    size_t distinct_callers() const { return by_caller_.size(); }
+
+    // Binary search needs the current window in timestamp order; false once
+    // the record that broke the order has been overwritten.
+    bool ordered() const { return last_unordered_ <= oldest_ticket(); }
+
+    // All calls with from <= timestamp < to, oldest first, as up to two spans.
+    bool time_range(int64_t from, int64_t to, pair<CallSpan, CallSpan> &out, string &err) const {
+        if (!ordered()) { err = "ring window is not in timestamp order"; return false; }
+        size_t lo = lower_bound_logical(0, size(), [&](size_t i) { return at_logical(i).timestamp < from; });
+        size_t hi = lower_bound_logical(lo, size(), [&](size_t i) { return at_logical(i).timestamp < to; });
+        out = {CallSpan(), CallSpan()};
+        if (lo == hi) return true;
+        size_t a = physical(lo), n = hi - lo;
+        size_t first = min(n, capacity_ - a);
+        out.first = {&buffer_[a], first};
+        if (first < n) out.second = {&buffer_[0], n - first};
+        return true;
+    }
+
+    // Calls placed by one number in [from, to), oldest first; fn(const PackedCall&).
+    // Returns the number visited, or -1 when the window is out of order.
+    template<typename Fn>
+    long for_each_by_caller(uint64_t caller, uint8_t caller_digits, int64_t from, int64_t to, Fn fn) const {
+        if (!ordered()) return -1;
+        auto it = by_caller_.find(phone_key(caller, caller_digits));
+        if (it == by_caller_.end()) return 0;
+        const vector<uint64_t> &tickets = it->second.tickets;
+        auto first = partition_point(tickets.begin() + it->second.front, tickets.end(),
+                                     [&](uint64_t t) { return buffer_[t % capacity_].timestamp < from; });
+        long visited = 0;
+        for (auto t = first; t != tickets.end(); ++t) {
+            const PackedCall &rec = buffer_[*t % capacity_];
+            if (rec.timestamp >= to) break;
+            fn(rec);
+            ++visited;
+        }
+        return visited;
+    }
+
+private:
+    // Live tickets of one caller are tickets[front..]; evicted ones are
+    // dropped lazily so the index costs 8 bytes per record plus one small
+    // header per distinct caller.
+    struct CallerTickets {
+        vector<uint64_t> tickets;
+        size_t front = 0;
+        // Drop the oldest ticket; false when none remain
+        bool pop_front() {
+            if (++front == tickets.size()) return false;
+            if (front * 2 > tickets.size()) {
+                tickets.erase(tickets.begin(), tickets.begin() + front);
+                front = 0;
+            }
+            return true;
+        }
+    };
+
+    uint64_t oldest_ticket() const { return head_ > capacity_ ? head_ - capacity_ : 0; }
+    size_t physical(size_t logical) const { return (size_t)((oldest_ticket() + logical) % capacity_); }
+    const PackedCall &at_logical(size_t i) const { return buffer_[physical(i)]; }
+
+    // First logical index in [lo, hi) where before(i) is false
+    template<typename Pred>
+    static size_t lower_bound_logical(size_t lo, size_t hi, Pred before) {
+        while (lo < hi) {
+            size_t mid = lo + (hi - lo) / 2;
+            if (before(mid)) lo = mid + 1;
+            else hi = mid;
+        }
+        return lo;
+    }
+
+    size_t capacity_;
+    vector<PackedCall> buffer_;
+    uint64_t head_ = 0;                 // tickets pushed so far
+    int64_t last_timestamp_ = 0;
+    uint64_t last_unordered_ = 0;       // newest ticket whose timestamp went backwards (0 = none)
+    unordered_map<uint64_t, CallerTickets> by_caller_;
+};
+
 // --------------------------- CSV loader -----------------------------------
 
 bool parse_csv_row_simple(const string &line, vector<string> &cols) {
@@ -219,27 +737,246 @@ bool load_calls_csv(const string &filename, vector<CallRecord> &out, string &err
     return true;
 }
 
+// -------------------------- Contention benchmark --------------------------
+
+constexpr int AUDIT_INTERVAL_US = 100;
+
+// Run `threads` producers pushing `ops` records in total while one auditor
+// thread takes a snapshot every AUDIT_INTERVAL_US. Returns million pushes per second.
+template<typename Ring, typename Record, typename Snapshot>
+double time_pushes(Ring &ring, const vector<Record> &payload, int threads, size_t ops,
+                   Snapshot take_snapshot, size_t &audits) {
+    atomic<int> running{threads};
+    atomic<bool> go{false};
+    audits = 0;
+    thread auditor([&] {
+        while (!go.load()) this_thread::yield();
+        while (running.load(memory_order_relaxed) > 0) {
+            take_snapshot(ring);
+            ++audits;
+            this_thread::sleep_for(chrono::microseconds(AUDIT_INTERVAL_US));
+        }
+    });
+    vector<thread> producers;
+    size_t per_thread = ops / threads;
+    for (int p = 0; p < threads; ++p) producers.emplace_back([&, p] {
+        while (!go.load()) this_thread::yield();
+        size_t off = (size_t)p * 7919;
+        for (size_t i = 0; i < per_thread; ++i) ring.push(payload[(off + i) % payload.size()]);
+        --running;
+    });
+    auto t0 = chrono::steady_clock::now();
+    go = true;
+    for (auto &th : producers) th.join();
+    auto t1 = chrono::steady_clock::now();
+    auditor.join();
+    double secs = chrono::duration<double>(t1 - t0).count();
+    return (double)(per_thread * threads) / secs / 1e6;
+}
+
+// Producers push tagged records (caller = producer id, duration = per-producer
+// sequence) while an auditor checks every snapshot: no more than K records,
+// and each producer's records appear in the order it pushed them.
+size_t verify_snapshot_order(size_t K, int threads, size_t per_thread, size_t &audits) {
+    LockFreeRing<CallRecord> ring(K);
+    atomic<int> running{threads};
+    size_t violations = 0;
+    audits = 0;
+    thread auditor([&] {
+        while (running.load() > 0) {
+            auto snap = ring.snapshot();
+            if (snap.size() > K) ++violations;
+            vector<int> last(threads, -1);
+            for (auto &r : snap) {
+                int p = stoi(r.caller);
+                if (r.duration_seconds <= last[p]) ++violations;
+                last[p] = r.duration_seconds;
+            }
+            ++audits;
+        }
+    });
+    vector<thread> producers;
+    for (int p = 0; p < threads; ++p) producers.emplace_back([&, p] {
+        CallRecord rec;
+        rec.caller = to_string(p);
+        for (size_t i = 0; i < per_thread; ++i) {
+            rec.duration_seconds = (int)i;
+            ring.push(rec);
+        }
+        --running;
+    });
+    for (auto &th : producers) th.join();
+    auditor.join();
+    if (ring.snapshot().size() != min<size_t>(K, per_thread * threads)) ++violations;
+    return violations;
+}
+
+// When bench_ring is non-empty the persistent PackedCall ring (created at
+// that path, removed afterwards) is measured alongside.
+void run_contention_benchmark(const vector<CallRecord> &payload, const vector<PackedCall> &packed,
+                              size_t K, int max_threads, size_t ops, const string &bench_ring) {
+    bool with_mmap = !bench_ring.empty() && !packed.empty();
+    cout << "Contention benchmark: K=" << K << ", " << ops << " pushes per run, 1 concurrent auditor\n";
+    cout << "threads   mutex Mpush/s   lock-free Mpush/s   speedup" << (with_mmap ? "   mmap Mpush/s" : "")
+         << "   audits (mutex / lock-free" << (with_mmap ? " / mmap" : "") << ")\n";
+    cout << fixed << setprecision(2);
+    for (int t = 1;; t = min(t * 2, max_threads)) {
+        size_t mutex_audits = 0, lf_audits = 0, mm_audits = 0;
+        RingBuffer<CallRecord> locked(K);
+        double m = time_pushes(locked, payload, t, ops,
+                               [](const RingBuffer<CallRecord> &r) { return r.get_all().size(); }, mutex_audits);
+        LockFreeRing<CallRecord> lockfree(K);
+        double l = time_pushes(lockfree, payload, t, ops,
+                               [](const LockFreeRing<CallRecord> &r) { return r.snapshot().size(); }, lf_audits);
+        cout << setw(7) << t << setw(16) << m << setw(20) << l << setw(9) << l / m << "x";
+        if (with_mmap) {
+            std::remove(bench_ring.c_str());
+            MappedCallRing mapped;
+            string err;
+            double mm = 0;
+            if (mapped.open(bench_ring, K, err))
+                mm = time_pushes(mapped, packed, t, ops,
+                                 [](const MappedCallRing &r) { return r.snapshot().size(); }, mm_audits);
+            else cerr << err << "\n";
+            cout << setw(15) << mm;
+        }
+        cout << setw(14) << mutex_audits << " / " << lf_audits;
+        if (with_mmap) cout << " / " << mm_audits;
+        cout << "\n";
+        if (t == max_threads) break;
+    }
+    if (with_mmap) std::remove(bench_ring.c_str());
+    cout.unsetf(ios::fixed);
+    size_t audits = 0;
+    size_t violations = verify_snapshot_order(K, max_threads, ops / max_threads, audits);
+    cout << "Snapshot consistency: " << audits << " snapshots checked under " << max_threads
+         << " producers, " << violations << " violations\n";
+}
+
+// Synthetic audit ring of n calls (one every ~60ms from callers drawn from a
+// pool) queried with random five-minute windows; results are checked
+// against a linear scan on a sample.
+void run_audit_query_benchmark(size_t n, size_t queries) {
+    const size_t CALLERS = 20000;
+    mt19937_64 rng(7);
+    CallAuditRing ring(n);
+    vector<uint64_t> numbers(CALLERS);
+    for (auto &num : numbers) num = 910000000000ULL + rng() % 10000000000ULL;
+    const int64_t START = 1764547200;   // 2025-12-01 00:00:00
+    int64_t ts = START, elapsed_ms = 0;
+    auto build0 = chrono::steady_clock::now();
+    PackedCall pc;
+    memset(&pc, 0, sizeof(pc));
+    pc.caller_digits = pc.callee_digits = PHONE_PLUS | 12;
+    pc.status = CallStatus::Connected;
+    pc.flags = PACKED_VALID;
+    // Push a quarter more than fits so the window wraps and callers' oldest calls are evicted
+    for (size_t i = 0; i < n + n / 4; ++i) {
+        elapsed_ms += (int64_t)(rng() % 120);   // 0-119ms gaps, ~60ms on average
+        ts = START + elapsed_ms / 1000;
+        pc.timestamp = ts;
+        pc.caller = numbers[rng() % CALLERS];
+        pc.callee = numbers[rng() % CALLERS];
+        pc.duration_seconds = (uint32_t)(rng() % 3600);
+        string id = "SYN" + to_string(i);
+        memcpy(pc.call_id, id.data(), min(id.size(), sizeof(pc.call_id)));
+        ring.push(pc);
+    }
+    auto build1 = chrono::steady_clock::now();
+    pair<CallSpan, CallSpan> all;
+    string err;
+    ring.time_range(INT64_MIN, INT64_MAX, all, err);
+    int64_t t0 = all.first.data[0].timestamp;
+    cout << "Built audit ring: " << ring.size() << " calls, " << ring.distinct_callers() << " callers, "
+         << (ts - t0) / 3600.0 << " hours, in " << chrono::duration<double, milli>(build1 - build0).count() << " ms\n";
+
+    const int64_t WINDOW = 300;
+    size_t mismatches = 0, total_hits = 0, caller_hits = 0;
+    double range_us = 0, caller_us = 0;
+    for (size_t q = 0; q < queries; ++q) {
+        int64_t from = t0 + (int64_t)(rng() % (uint64_t)max<int64_t>(1, ts - t0));
+        int64_t to = from + WINDOW;
+        auto a = chrono::steady_clock::now();
+        pair<CallSpan, CallSpan> spans;
+        ring.time_range(from, to, spans, err);
+        auto b = chrono::steady_clock::now();
+        uint64_t who = numbers[rng() % CALLERS];
+        long by = ring.for_each_by_caller(who, PHONE_PLUS | 12, from, from + 24 * 3600, [](const PackedCall&) {});
+        auto c = chrono::steady_clock::now();
+        range_us += chrono::duration<double, micro>(b - a).count();
+        caller_us += chrono::duration<double, micro>(c - b).count();
+        size_t hits = spans.first.size + spans.second.size;
+        total_hits += hits;
+        caller_hits += (size_t)max(0L, by);
+        if (q < 10) {
+            // Linear reference over the whole window
+            size_t expect = 0;
+            long expect_by = 0;
+            for (const CallSpan *sp : {&all.first, &all.second})
+                for (auto &r : *sp) {
+                    expect += (r.timestamp >= from && r.timestamp < to);
+                    expect_by += (r.caller == who && r.timestamp >= from && r.timestamp < from + 24 * 3600);
+                }
+            if (expect != hits || expect_by != by) ++mismatches;
+            for (const CallSpan *sp : {&spans.first, &spans.second})
+                for (auto &r : *sp) if (r.timestamp < from || r.timestamp >= to) ++mismatches;
+        }
+    }
+    cout << fixed << setprecision(2);
+    cout << "Time range (5 min): " << range_us / queries << " us avg, " << (double)total_hits / queries << " calls avg\n";
+    cout << "Per caller (24 h):  " << caller_us / queries << " us avg, " << (double)caller_hits / queries << " calls avg\n";
+    cout.unsetf(ios::fixed);
+    cout << "Checked 10 queries against a linear scan: " << mismatches << " mismatches\n";
+}
+
 // ----------------------------- Demo main ----------------------------------
 
 int main(int argc, char** argv) {
     ios::sync_with_stdio(false);
     cin.tie(nullptr);
     if (argc < 2) {
-        cerr << "Usage: " << argv[0] << " calls.csv [K=100] [--output audit_last_k.csv]\n";
+        cerr << "Usage: " << argv[0] << " calls.csv [K=100] [--output audit_last_k.csv] [--lockfree]\n"
+             << "       [--mmap ring.bin] [--bench] [--threads MAX=32] [--ops N=2000000]\n"
+             << "       [--range FROM TO [--caller NUMBER]]   (FROM/TO as \"YYYY-MM-DD HH:MM[:SS]\")\n"
+             << "       " << argv[0] << " --audit-bench N [--queries Q=1000]\n";
         return 1;
     }
-    string infile = argv[1];
+    string infile = argv[1][0] == '-' ? "" : argv[1];
     size_t K = 100;
     string outfile = "audit_last_k.csv";
-    for (int i = 2; i < argc; ++i) {
+    string mmap_file;
+    bool use_lockfree = false, bench = false;
+    int max_threads = 32;
+    size_t bench_ops = 2000000;
+    string range_from, range_to, range_caller;
+    size_t audit_bench = 0, audit_queries = 1000;
+    for (int i = infile.empty() ? 1 : 2; i < argc; ++i) {
         string s = argv[i];
         if (s == "--output" && i+1 < argc) { outfile = argv[++i]; }
+        else if (s == "--lockfree") use_lockfree = true;
+        else if (s == "--mmap" && i+1 < argc) mmap_file = argv[++i];
+        else if (s == "--bench") bench = true;
+        else if (s == "--threads" && i+1 < argc) max_threads = max(1, stoi(argv[++i]));
+        else if (s == "--ops" && i+1 < argc) bench_ops = stoul(argv[++i]);
+        else if (s == "--range" && i+2 < argc) { range_from = argv[++i]; range_to = argv[++i]; }
+        else if (s == "--caller" && i+1 < argc) range_caller = argv[++i];
+        else if (s == "--audit-bench" && i+1 < argc) audit_bench = stoul(argv[++i]);
+        else if (s == "--queries" && i+1 < argc) audit_queries = max<size_t>(1, stoul(argv[++i]));
         else {
             // try parse K
             try { K = stoul(s); } catch(...) { /* ignore */ }
         }
     }
 
+    if (audit_bench > 0) {
+        run_audit_query_benchmark(audit_bench, audit_queries);
+        return 0;
+    }
+    if (infile.empty()) {
+        cerr << "Missing calls.csv\n";
+        return 1;
+    }
+
     vector<CallRecord> calls;
     string err;
     if (!load_calls_csv(infile, calls, err)) {
@@ -247,19 +984,103 @@ int main(int argc, char** argv) {
         return 1;
     }
     cout << "Loaded " << calls.size() << " call records from " << infile << "\n";
-    cout << "Initializing ring buffer with capacity K=" << K << "\n";
+    if (calls.empty()) {
+        cerr << "No call records loaded\n";
+        return 1;
+    }
 
-    RingBuffer<CallRecord> ring(K);
+    // Fixed-width encoding for the persistent ring
+    vector<PackedCall> packed;
+    if (!mmap_file.empty() || !range_from.empty()) {
+        size_t bad = 0;
+        packed.reserve(calls.size());
+        for (auto &rec : calls) {
+            PackedCall pc;
+            if (pack_call(rec, pc, err)) packed.push_back(pc);
+            else if (bad++ == 0) cerr << "Skipping unencodable record: " << err << "\n";
+        }
+        if (bad) cerr << "Skipped " << bad << " records that do not fit the packed layout\n";
+    }
 
-    // Simulate streaming ingestion: push all calls into ring buffer.
-    for (size_t i = 0; i < calls.size(); ++i) {
-        ring.push(calls[i]);
+    if (bench) {
+        run_contention_benchmark(calls, packed, K, max_threads, bench_ops, mmap_file.empty() ? "" : mmap_file + ".bench");
+        return 0;
     }
 
-    cout << "After ingestion, buffer size = " << ring.size() << " (<= K)\n";
+    if (!range_from.empty()) {
+        int64_t from, to;
+        if (!parse_call_timestamp(range_from, from) || !parse_call_timestamp(range_to, to)) {
+            cerr << "Bad --range timestamps (expected \"YYYY-MM-DD HH:MM[:SS]\")\n";
+            return 1;
+        }
+        // Live feeds arrive in timestamp order; a CSV export may not.
+        if (!is_sorted(packed.begin(), packed.end(), [](const PackedCall &a, const PackedCall &b) { return a.timestamp < b.timestamp; })) {
+            cout << "Input not in timestamp order; sorting before ingestion\n";
+            stable_sort(packed.begin(), packed.end(), [](const PackedCall &a, const PackedCall &b) { return a.timestamp < b.timestamp; });
+        }
+        CallAuditRing audit(K);
+        for (auto &pc : packed) audit.push(pc);
+        vector<CallRecord> hits;
+        auto t0 = chrono::steady_clock::now();
+        if (range_caller.empty()) {
+            pair<CallSpan, CallSpan> spans;
+            if (!audit.time_range(from, to, spans, err)) { cerr << "Range query failed: " << err << "\n"; return 1; }
+            for (const CallSpan *sp : {&spans.first, &spans.second})
+                for (auto &pc : *sp) hits.push_back(unpack_call(pc));
+        } else {
+            uint64_t num;
+            uint8_t digits;
+            if (!pack_phone(range_caller, num, digits)) { cerr << "Bad --caller number: " << range_caller << "\n"; return 1; }
+            audit.for_each_by_caller(num, digits, from, to, [&](const PackedCall &pc) { hits.push_back(unpack_call(pc)); });
+        }
+        auto t1 = chrono::steady_clock::now();
+        cout << hits.size() << " calls" << (range_caller.empty() ? "" : " by " + range_caller) << " in [" << range_from
+             << ", " << range_to << ") among the last " << audit.size() << " (" << chrono::duration<double, micro>(t1 - t0).count() << " us)\n";
+        for (auto &r : hits)
+            cout << r.call_id << " | " << r.caller << " -> " << r.callee << " | " << r.timestamp << " | dur=" << r.duration_seconds << " | " << r.status << "\n";
+        vector<string> header = {"call_id","caller","callee","timestamp","duration_seconds","status"};
+        if (write_rows_csv(outfile, header, hits)) cout << "Wrote " << hits.size() << " calls to " << outfile << "\n";
+        else cerr << "Failed to write output file " << outfile << "\n";
+        return 0;
+    }
+
+    RingBuffer<CallRecord> ring(K);
+    LockFreeRing<CallRecord> lf_ring(K);
+    MappedCallRing mapped;
+    vector<CallRecord> all;
+
+    if (!mmap_file.empty()) {
+        if (!mapped.open(mmap_file, K, err)) {
+            cerr << "Error opening ring file: " << err << "\n";
+            return 1;
+        }
+        cout << "Opened persistent ring " << mmap_file << " (capacity " << mapped.capacity() << ", "
+             << mapped.pushed() << " calls recorded before this run";
+        if (mapped.recovered()) cout << ", " << mapped.recovered() << " torn slots cleared";
+        cout << ")\n";
+        if (mapped.capacity() != K) cout << "Note: existing ring file keeps its capacity; K=" << K << " ignored\n";
+        auto t0 = chrono::steady_clock::now();
+        for (auto &pc : packed) mapped.push(pc);
+        auto t1 = chrono::steady_clock::now();
+        if (!mapped.sync()) cerr << "msync failed for " << mmap_file << "\n";
+        cout << "Appended " << packed.size() << " calls in "
+             << chrono::duration<double, micro>(t1 - t0).count() << " us, buffer size = " << mapped.size() << " (<= K)\n";
+        for (auto &pc : mapped.snapshot()) all.push_back(unpack_call(pc));
+    } else {
+        cout << "Initializing " << (use_lockfree ? "lock-free " : "") << "ring buffer with capacity K=" << K << "\n";
+
+        // Simulate streaming ingestion: push all calls into ring buffer.
+        for (size_t i = 0; i < calls.size(); ++i) {
+            if (use_lockfree) lf_ring.push(calls[i]);
+            else ring.push(calls[i]);
+        }
+
+        size_t ring_size = use_lockfree ? lf_ring.size() : ring.size();
+        cout << "After ingestion, buffer size = " << ring_size << " (<= K)\n";
+        all = use_lockfree ? lf_ring.snapshot() : ring.get_all();
+    }
 
     // Retrieve oldest->newest and print first 10
-    auto all = ring.get_all();
     cout << "Oldest -> Newest (showing up to 10):\n";
     for (size_t i = 0; i < all.size() && i < 10; ++i) {
         const auto &r = all[i];
@@ -268,14 +1089,14 @@ int main(int argc, char** argv) {
 
     // Save audit file
     vector<string> header = {"call_id","caller","callee","timestamp","duration_seconds","status"};
-    if (ring.serialize_to_csv(outfile, header)) {
-        cout << "Wrote last " << ring.size() << " calls to " << outfile << "\n";
+    if (write_rows_csv(outfile, header, all)) {
+        cout << "Wrote last " << all.size() << " calls to " << outfile << "\n";
     } else {
         cerr << "Failed to write output file " << outfile << "\n";
     }
 
     // Example: random access: print newest entry
-    if (ring.size() > 0) {
+    if (!use_lockfree && mmap_file.empty() && ring.size() > 0) {
         size_t sz = ring.size();
         try {
             auto newest = ring.get_at_oldest_index(sz - 1);
@@ -283,6 +1104,8 @@ int main(int argc, char** argv) {
         } catch (const exception &e) {
             cerr << "Random access error: " << e.what() << "\n";
         }
+    } else if (!all.empty()) {
+        cout << "Newest entry: " << all.back().call_id << " at " << all.back().timestamp << "\n";
     }
 
     return 0;